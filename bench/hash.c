@@ -0,0 +1,134 @@
+// microbenchmark for hashString(): throughput over a range of key
+// lengths and collision behaviour under power-of-two masking, compared
+// against the byte-at-a-time FNV-1a hash it replaced.
+// build and run with "make bench-hash"
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "hash.h"
+
+typedef uint32_t (*HashFn)(const char *key, int length);
+
+static uint32_t fnv1a(const char *key, int length)
+{
+	uint32_t hash = 2166136261u;
+	for (int i = 0; i < length; i++)
+	{
+		hash ^= (uint8_t)key[i];
+		hash *= 16777619;
+	}
+	return hash;
+}
+
+static double now()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// hashes a buffer of the given key length until ~1 GB went through
+static void throughput(const char *name, HashFn hash, int length)
+{
+	char *key = malloc(length + 1);
+	for (int i = 0; i < length; i++)
+		key[i] = 'a' + (i * 7) % 26;
+
+	long iterations = (1L << 30) / (length + 8);
+	volatile uint32_t sink = 0;
+
+	double start = now();
+	for (long i = 0; i < iterations; i++)
+	{
+		key[0] = (char)i;
+		sink ^= hash(key, length);
+	}
+	double elapsed = now() - start;
+
+	printf("  %-6s %8d B  %9.1f MB/s  %7.2f ns/key\n", name, length,
+		   (double)iterations * length / elapsed / 1e6,
+		   elapsed / iterations * 1e9);
+	free(key);
+}
+
+// inserts count keys into an open-addressing table of the smallest
+// power-of-two capacity at load <= 0.75 (like Table does) and reports
+// the share of keys that missed their home slot and the mean probe length
+static void collisions(const char *name, HashFn hash,
+					   const char *set, char **keys, int count)
+{
+	int capacity = 8;
+	while (count > capacity * 0.75)
+		capacity *= 2;
+
+	char *used = calloc(capacity, 1);
+	long probes = 0;
+	int displaced = 0;
+
+	for (int i = 0; i < count; i++)
+	{
+		uint32_t index = hash(keys[i], strlen(keys[i])) & (capacity - 1);
+		if (used[index])
+			displaced++;
+		while (used[index])
+		{
+			index = (index + 1) & (capacity - 1);
+			probes++;
+		}
+		used[index] = 1;
+		probes++;
+	}
+
+	printf("  %-6s %-12s %7d keys  %5.1f%% displaced  %5.2f probes/key\n",
+		   name, set, count, 100.0 * displaced / count, (double)probes / count);
+	free(used);
+}
+
+static char **makeKeys(const char *format, int count, int scale)
+{
+	char **keys = malloc(sizeof(char *) * count);
+	for (int i = 0; i < count; i++)
+	{
+		char buf[64];
+		snprintf(buf, sizeof(buf), format, i * scale);
+		keys[i] = strdup(buf);
+	}
+	return keys;
+}
+
+int main()
+{
+	int lengths[] = {3, 8, 16, 32, 100, 1000, 1 << 20};
+	int nlengths = sizeof(lengths) / sizeof(lengths[0]);
+
+	printf("throughput:\n");
+	for (int i = 0; i < nlengths; i++)
+	{
+		throughput("fnv1a", fnv1a, lengths[i]);
+		throughput("wyhash", hashString, lengths[i]);
+	}
+
+	printf("collisions:\n");
+	int count = 100000;
+	struct { const char *name; const char *format; int scale; } sets[] = {
+		{"sequential", "k%d", 1},
+		{"stride-64", "field_%d", 64},
+		{"numeric", "%d", 1},
+	};
+	for (int i = 0; i < 3; i++)
+	{
+		char **keys = makeKeys(sets[i].format, count, sets[i].scale);
+		collisions("fnv1a", fnv1a, sets[i].name, keys, count);
+		collisions("wyhash", hashString, sets[i].name, keys, count);
+		for (int j = 0; j < count; j++)
+			free(keys[j]);
+		free(keys);
+	}
+
+	return 0;
+}
@@ -0,0 +1,141 @@
+// microbenchmark for parseNumber() and formatNumber() against strtod()
+// and snprintf("%.17g") on typical numeric fields.
+// build and run with "make bench-number"
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "number.h"
+
+#define COUNT 1000000
+
+static double now()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static uint64_t state = 88172645463325252ull;
+static uint64_t next()
+{
+	state ^= state << 13;
+	state ^= state >> 7;
+	state ^= state << 17;
+	return state;
+}
+
+// fills fields with COUNT numbers of the given kind as text
+static char **makeFields(const char *kind)
+{
+	char **fields = malloc(sizeof(char *) * COUNT);
+	for (int i = 0; i < COUNT; i++)
+	{
+		char buf[64];
+		if (strcmp(kind, "integers") == 0)
+			snprintf(buf, sizeof(buf), "%llu", (unsigned long long)(next() % 10000000));
+		else if (strcmp(kind, "prices") == 0)
+			snprintf(buf, sizeof(buf), "%llu.%02llu", (unsigned long long)(next() % 100000),
+					 (unsigned long long)(next() % 100));
+		else
+		{
+			double value;
+			uint64_t bits = next() >> 2 | 0x3000000000000000ull;
+			memcpy(&value, &bits, sizeof(value));
+			snprintf(buf, sizeof(buf), "%.17g", value);
+		}
+		fields[i] = strdup(buf);
+	}
+	return fields;
+}
+
+static void parsing(const char *kind)
+{
+	char **fields = makeFields(kind);
+	int *lengths = malloc(sizeof(int) * COUNT);
+	for (int i = 0; i < COUNT; i++)
+		lengths[i] = strlen(fields[i]);
+
+	volatile double sink = 0;
+	int mismatches = 0;
+
+	double start = now();
+	for (int i = 0; i < COUNT; i++)
+		sink += strtod(fields[i], NULL);
+	double strtodTime = now() - start;
+
+	start = now();
+	for (int i = 0; i < COUNT; i++)
+	{
+		double value;
+		parseNumber(fields[i], lengths[i], &value);
+		sink += value;
+	}
+	double parseTime = now() - start;
+
+	for (int i = 0; i < COUNT; i++)
+	{
+		double value;
+		parseNumber(fields[i], lengths[i], &value);
+		if (value != strtod(fields[i], NULL))
+			mismatches++;
+	}
+
+	printf("  %-10s strtod %6.1f ns  parseNumber %6.1f ns  (%.1fx, %d mismatches)\n",
+		   kind, strtodTime / COUNT * 1e9, parseTime / COUNT * 1e9,
+		   strtodTime / parseTime, mismatches);
+
+	for (int i = 0; i < COUNT; i++)
+		free(fields[i]);
+	free(fields);
+	free(lengths);
+}
+
+static void formatting(const char *kind)
+{
+	char **fields = makeFields(kind);
+	double *values = malloc(sizeof(double) * COUNT);
+	for (int i = 0; i < COUNT; i++)
+		values[i] = strtod(fields[i], NULL);
+
+	char buffer[NUMBER_BUFFER_SIZE];
+	volatile int sink = 0;
+
+	double start = now();
+	for (int i = 0; i < COUNT; i++)
+		sink += snprintf(buffer, sizeof(buffer), "%.17g", values[i]);
+	double snprintfTime = now() - start;
+
+	start = now();
+	for (int i = 0; i < COUNT; i++)
+		sink += formatNumber(values[i], buffer);
+	double formatTime = now() - start;
+
+	printf("  %-10s snprintf %6.1f ns  formatNumber %6.1f ns  (%.1fx)\n",
+		   kind, snprintfTime / COUNT * 1e9, formatTime / COUNT * 1e9,
+		   snprintfTime / formatTime);
+
+	for (int i = 0; i < COUNT; i++)
+		free(fields[i]);
+	free(fields);
+	free(values);
+}
+
+int main()
+{
+	const char *kinds[] = {"integers", "prices", "doubles"};
+
+	printf("parsing:\n");
+	for (int i = 0; i < 3; i++)
+		parsing(kinds[i]);
+
+	printf("formatting:\n");
+	for (int i = 0; i < 3; i++)
+		formatting(kinds[i]);
+
+	return 0;
+}
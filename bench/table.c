@@ -0,0 +1,423 @@
+// randomized checks for the string keyed Table: inserts, deletes and
+// lookups against a plain array of what should be there, with probes
+// that cross group boundaries, wrap around and run over tombstones,
+// and tables moving between the linear and the grouped layout. the
+// intern table is checked across collections that drop most strings.
+// exits with 1 on the first mismatch.
+// build and run with "make bench-table"
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "hash.h"
+#include "mem.h"
+#include "object.h"
+#include "table.h"
+#include "vm.h"
+
+// see table.c
+#define GROUP_SIZE 16
+#define CTRL_DELETED ((int8_t)-2)
+
+#define KEY_COUNT 4096
+
+static ObjArray *roots; // keeps the keys alive
+static ObjString *keys[KEY_COUNT];
+static bool present[KEY_COUNT];
+
+static double now()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static uint64_t state = 88172645463325252ull;
+static uint64_t next()
+{
+	state ^= state << 13;
+	state ^= state >> 7;
+	state ^= state << 17;
+	return state;
+}
+
+static void fail(const char *where, const char *what)
+{
+	fprintf(stderr, "%s: %s\n", where, what);
+	exit(1);
+}
+
+// an interned key rooted for the whole run
+static ObjString *makeKey(const char *format, int i)
+{
+	char buf[64];
+	int length = snprintf(buf, sizeof(buf), format, i);
+	ObjString *key = copyString(buf, length);
+	push(OBJ_VAL(key));
+	writeValueArray(&roots->array, OBJ_VAL(key));
+	writeValueBarrier((Obj *)roots, OBJ_VAL(key));
+	pop();
+	return key;
+}
+
+static bool isLinear(Table *table)
+{
+	return table->ctrl == NULL;
+}
+
+// the slot holding key, or -1
+static int slotOf(Table *table, ObjString *key)
+{
+	for (int i = 0; i < table->capacity; i++)
+	{
+		if ((isLinear(table) ? i < table->count : table->ctrl[i] >= 0) &&
+			table->keys[i] == key)
+			return i;
+	}
+	return -1;
+}
+
+// compares the control bytes of a table with its counters
+static void checkCounters(Table *table, const char *where)
+{
+	if (isLinear(table))
+	{
+		if (table->capacity > 8 || table->tombstones != 0)
+			fail(where, "bad linear table");
+		return;
+	}
+
+	if (table->capacity % GROUP_SIZE != 0 ||
+		(table->capacity & (table->capacity - 1)) != 0)
+		fail(where, "bad capacity");
+	int full = 0, deleted = 0;
+	for (int i = 0; i < table->capacity; i++)
+	{
+		int8_t ctrl = table->ctrl[i];
+		if (ctrl >= 0 && ctrl != (int8_t)(table->keys[i]->hash & 0x7F))
+			fail(where, "control byte does not match the key");
+		full += ctrl >= 0;
+		deleted += ctrl == CTRL_DELETED;
+	}
+	if (full != table->count || deleted != table->tombstones)
+		fail(where, "counters do not match the control bytes");
+}
+
+// compares the table with present[] for the first count keys, and
+// its control bytes with its counters
+static void check(Table *table, int count, const char *where)
+{
+	int live = 0;
+	for (int i = 0; i < count; i++)
+	{
+		Value value;
+		bool found = tableGet(table, keys[i], &value);
+		if (found != present[i])
+			fail(where, found ? "deleted key found" : "live key lost");
+		if (found && AS_NUMBER(value) != i)
+			fail(where, "wrong value");
+		live += present[i];
+	}
+	if (table->count != live)
+		fail(where, "wrong count");
+	checkCounters(table, where);
+}
+
+static void set(Table *table, int i)
+{
+	bool isNew = tableSet(table, keys[i], NUMBER_VAL(i));
+	if (isNew == present[i])
+		fail("set", "wrong new key result");
+	present[i] = true;
+}
+
+static void delete(Table *table, int i)
+{
+	if (tableDelete(table, keys[i]) != present[i])
+		fail("delete", "wrong result");
+	present[i] = false;
+}
+
+// keys that all start probing in the last of four groups overflow it
+// and wrap around into the first. deleting from the full group leaves
+// tombstones that the overflowed keys have to be found past
+static void wrapAround()
+{
+	Table table;
+	initTable(&table);
+	memset(present, 0, sizeof(present));
+
+	// 29 entries grow the table to 64 slots, which deleting keeps
+	for (int i = 0; i < 29; i++)
+		set(&table, i);
+	for (int i = 0; i < 29; i++)
+		delete(&table, i);
+	if (table.capacity != 64 || table.tombstones != 0)
+		fail("wrap", "expected an empty table of 64 slots");
+
+	// move the keys homed in group 3 to the front
+	int homed = 0;
+	for (int i = 0; i < KEY_COUNT && homed < 24; i++)
+	{
+		if (((keys[i]->hash >> 7) & 3) != 3)
+			continue;
+		ObjString *key = keys[i];
+		keys[i] = keys[homed];
+		keys[homed++] = key;
+	}
+	if (homed < 24)
+		fail("wrap", "not enough keys for group 3");
+
+	for (int i = 0; i < 24; i++)
+		set(&table, i);
+	check(&table, KEY_COUNT, "wrap insert");
+	if (table.capacity != 64)
+		fail("wrap", "table grew");
+
+	int wrapped = 0;
+	for (int i = 0; i < 24; i++)
+		wrapped += slotOf(&table, keys[i]) < GROUP_SIZE;
+	if (wrapped != 8)
+		fail("wrap", "expected 8 keys in the first group");
+
+	// group 3 is full, so its deletes leave tombstones
+	int deleted = 0;
+	for (int i = 0; i < 24 && deleted < 6; i++)
+	{
+		if (slotOf(&table, keys[i]) >= 3 * GROUP_SIZE)
+		{
+			delete(&table, i);
+			deleted++;
+		}
+	}
+	check(&table, KEY_COUNT, "wrap delete");
+	if (table.tombstones != 6)
+		fail("wrap", "expected 6 tombstones");
+
+	// inserts take the tombstones back
+	for (int i = 0; i < 24; i++)
+	{
+		if (!present[i])
+			set(&table, i);
+	}
+	check(&table, KEY_COUNT, "wrap reinsert");
+	if (table.tombstones != 0)
+		fail("wrap", "tombstones left after reinsert");
+
+	freeTable(&table);
+}
+
+static void expectLayout(Table *table, bool linear, int capacity, const char *where)
+{
+	check(table, KEY_COUNT, where);
+	if (isLinear(table) != linear || table->capacity != capacity)
+		fail(where, "unexpected layout");
+}
+
+// small tables are linear up to 8 slots and turn into one group past
+// that. tableCompact() turns them back once most entries are gone
+static void layouts()
+{
+	Table table;
+	initTable(&table);
+	memset(present, 0, sizeof(present));
+
+	int capacities[] = {2, 2, 4, 4, 8, 8, 8, 8};
+	for (int i = 0; i < 8; i++)
+	{
+		set(&table, i);
+		expectLayout(&table, true, capacities[i], "linear growth");
+	}
+	set(&table, 8);
+	expectLayout(&table, false, 16, "first group");
+
+	// deleting never shrinks, compacting does
+	for (int i = 0; i < 6; i++)
+		delete(&table, i);
+	expectLayout(&table, false, 16, "group delete");
+	if (!tableCompact(&table))
+		fail("group compact", "did not shrink");
+	expectLayout(&table, true, 4, "group compact");
+
+	// a linear delete moves the last entry into the hole
+	ObjString *last = table.keys[2];
+	int first = 6;
+	while (table.keys[0] != keys[first])
+		first++;
+	delete(&table, first);
+	if (table.keys[0] != last)
+		fail("linear delete", "entries not packed");
+	expectLayout(&table, true, 4, "linear delete");
+	for (int i = 0; i < 9; i++)
+	{
+		if (!present[i])
+			set(&table, i);
+	}
+	expectLayout(&table, false, 16, "linear reinsert");
+	if (tableFindString(&table, keys[3]->chars, keys[3]->length, keys[3]->hash) != keys[3])
+		fail("linear reinsert", "string not found by its text");
+
+	// a bigger table shrinks straight into the linear layout
+	for (int i = 9; i < 20; i++)
+		set(&table, i);
+	expectLayout(&table, false, 32, "bigger");
+	for (int i = 0; i < 14; i++)
+		delete(&table, i);
+	if (!tableCompact(&table))
+		fail("bigger compact", "did not shrink");
+	expectLayout(&table, true, 8, "bigger compact");
+	if (tableFindString(&table, keys[19]->chars, keys[19]->length, keys[19]->hash) != keys[19])
+		fail("bigger compact", "string not found by its text");
+
+	// delete and reinsert the same keys while linear
+	for (int round = 0; round < 100; round++)
+	{
+		int i = 14 + next() % 6;
+		delete(&table, i);
+		expectLayout(&table, true, 8, "linear churn");
+		set(&table, i);
+		expectLayout(&table, true, 8, "linear churn");
+	}
+
+	for (int i = 14; i < 20; i++)
+		delete(&table, i);
+	tableCompact(&table);
+	expectLayout(&table, true, 0, "emptied");
+
+	freeTable(&table);
+}
+
+// the interned string with the given text, or NULL
+static ObjString *findInterned(const char *chars, int length)
+{
+	return tableFindString(&vm.strings, chars, length, hashString(chars, length));
+}
+
+// creates many interned strings and keeps a few. the others leave
+// vm.strings when they die, young ones in sweepYoung() and old ones
+// in a full collection, which also compacts the table. whatever is
+// kept has to stay findable, so copyString() never makes a twin.
+// the texts are longer than SHORT_STRING_MAX, so they go in vm.strings
+static void internCollections(int rounds, int perRound)
+{
+	ObjArray *kept = newArray();
+	push(OBJ_VAL(kept));
+	int before = vm.strings.count;
+	int peakCapacity = 0;
+	int minorBefore = vm.gcStats.minorCollections;
+
+	for (int round = 0; round < rounds; round++)
+	{
+		for (int i = 0; i < perRound; i++)
+		{
+			char buf[64];
+			int length = snprintf(buf, sizeof(buf), "interned-string-%d-%d", round, i);
+			ObjString *string = copyString(buf, length);
+			if (i % 16 != 0)
+				continue;
+			push(OBJ_VAL(string));
+			writeValueArray(&kept->array, OBJ_VAL(string));
+			writeValueBarrier((Obj *)kept, OBJ_VAL(string));
+			pop();
+		}
+		if (vm.strings.capacity > peakCapacity)
+			peakCapacity = vm.strings.capacity;
+		if (round % 4 == 3)
+			collectGarbage();
+		checkCounters(&vm.strings, "interned");
+
+		for (int i = 0; i < kept->array.count; i++)
+		{
+			ObjString *string = AS_STRING(kept->array.values[i]);
+			if (findInterned(string->chars, string->length) != string ||
+				copyString(string->chars, string->length) != string)
+				fail("interned", "kept string lost");
+		}
+	}
+
+	if (vm.gcStats.minorCollections == minorBefore)
+		fail("interned", "no minor collection ran");
+
+	// everything dropped is gone after a full collection
+	collectGarbage();
+	for (int round = 0; round < rounds; round++)
+	{
+		for (int i = 1; i < perRound; i += 7)
+		{
+			char buf[64];
+			int length = snprintf(buf, sizeof(buf), "interned-string-%d-%d", round, i);
+			if (i % 16 != 0 && findInterned(buf, length) != NULL)
+				fail("interned", "dead string still interned");
+		}
+	}
+
+	// dropping the kept ones too shrinks the table
+	kept->array.count = 0;
+	collectGarbage();
+	checkCounters(&vm.strings, "interned shrink");
+	if (vm.strings.count != before || vm.strings.capacity > peakCapacity / 4)
+		fail("interned shrink", "table did not shrink");
+
+	pop();
+}
+
+// random operations on a working set whose size changes over time, so
+// the table grows, fills with tombstones, rehashes and shrinks
+static void randomized(int operations)
+{
+	Table table;
+	initTable(&table);
+	memset(present, 0, sizeof(present));
+
+	int sizes[] = {KEY_COUNT, 300, 40, KEY_COUNT / 2, 100};
+	double start = now();
+	for (int op = 0; op < operations; op++)
+	{
+		int size = sizes[op / 50000 % 5];
+		int i = next() % size;
+		int kind = next() % 100;
+		if (kind < 50)
+			set(&table, i);
+		else if (kind < 99)
+			delete(&table, i);
+		else
+			tableCompact(&table);
+
+		if (op % 5000 == 0)
+			check(&table, KEY_COUNT, "random");
+	}
+	double elapsed = now() - start;
+	check(&table, KEY_COUNT, "random end");
+	printf("  %d random operations in %.1f ms\n", operations, elapsed * 1000);
+
+	freeTable(&table);
+}
+
+int main()
+{
+	initVM(true);
+	roots = newArray();
+	push(OBJ_VAL(roots));
+	for (int i = 0; i < KEY_COUNT; i++)
+		keys[i] = makeKey("table-key-%d", i);
+
+	wrapAround();
+	printf("wrap around: ok\n");
+
+	layouts();
+	printf("layouts: ok\n");
+
+	randomized(1000000);
+	printf("randomized: ok\n");
+
+	internCollections(32, 20000);
+	printf("intern table: ok\n");
+
+	pop();
+	freeVM();
+	return 0;
+}
@@ -8,6 +8,7 @@
 #include "object.h"
 #include "natives.h"
 #include "mem.h"
+#include "number.h"
 #ifdef DEBUG_PRINT_CODE
 #include "debug.h"
 #endif
@@ -130,6 +131,7 @@ static void postfix(bool canAssign);
 static void call(bool canAssign);
 static void literal(bool canAssign);
 static void string(bool canAssign);
+static void interpolation(bool canAssign);
 static void variable(bool canAssign);
 static void and_(bool canAssign);
 static void or_(bool canAssign);
@@ -138,6 +140,7 @@ static void this_(bool canAssign);
 static void super_(bool canAssign);
 static void index(bool canAssign);
 static void array(bool canAssign);
+static void map(bool canAssign);
 
 static void namedVariable(Token name, bool canAssign);
 
@@ -359,6 +362,47 @@ static void emitConstant(Value value)
 	emitBytes(OP_CONSTANT, makeConstant(value));
 }
 
+// heap copies of the types used so far, shared by every chunk of one
+// compile() since the VM never changes a type
+#define HEAP_TYPES_MAX 32
+static ObjDataType *heapTypes[HEAP_TYPES_MAX];
+static int heapTypeCount = 0;
+
+static bool typesEqual(ObjDataType *a, ObjDataType *b)
+{
+	return a->isAny == b->isAny && a->valueType == b->valueType &&
+		a->objType == b->objType && a->classType.name == b->classType.name;
+}
+
+// the heap copy of a compile-time type (Any if NULL). types held by the
+// compiler live in Locals or C locals, which are gone by the time the
+// chunk runs
+static ObjDataType *heapType(ObjDataType *type)
+{
+	ObjDataType any = anyType();
+	if (type == NULL)
+		type = &any;
+	for (int i = 0; i < heapTypeCount; i++)
+	{
+		if (typesEqual(heapTypes[i], type))
+			return heapTypes[i];
+	}
+
+	ObjDataType *copy = newDataType(NULL_VAL, true);
+	Obj header = copy->obj;
+	*copy = *type;
+	copy->obj = header;
+	if (heapTypeCount < HEAP_TYPES_MAX)
+		heapTypes[heapTypeCount++] = copy;
+	return copy;
+}
+
+// adds a heap copy of a compile-time type as a constant
+static uint8_t typeConstant(ObjDataType *type)
+{
+	return makeConstant(OBJ_VAL(heapType(type)));
+}
+
 // emits the opcodes n shit for a default value of the given type
 static void emitDefaultValue(ObjDataType *type)
 {
@@ -405,7 +449,8 @@ static int resolveNativeVar(Token *name)
 {
 	int count = sizeof NativeVars / sizeof NativeVars[0];
 	for (int i = 0; i < count; i++)
-		if (memcmp(NativeVars[i], name->start, name->length) == 0)
+		if ((int)strlen(NativeVars[i]) == name->length &&
+			memcmp(NativeVars[i], name->start, name->length) == 0)
 			return i;
 	return -1;
 }
@@ -489,7 +534,7 @@ static void addLocal(Token name)
 	local->name = name;
 	local->depth = -1; // mark uninitialized
 	local->isCaptured = false;
-	local->type = *newDataType(NULL_VAL, true);
+	local->type = anyType();
 }
 
 // like addLocal() but for upvalues
@@ -527,14 +572,14 @@ static Token syntheticToken(const char *text)
 }
 
 // parse a datatype identifier
-static ObjDataType *dataType(const char *errorMessage)
+static ObjDataType dataType(const char *errorMessage)
 {
 	consume(TOKEN_IDENTIFIER, errorMessage); // TODO: allow e.g. Fun keyword as well
-	ObjDataType *type = dataTypeFromString(
-		copyString(parser.previous.start, parser.previous.length)->chars);
+	ObjDataType type = dataTypeFromString(parser.previous.start, parser.previous.length);
 
-	if (type->invalid)
-		error(formatString("Invalid type: \"%s\".", copyString(parser.previous.start, parser.previous.length)->chars));
+	if (type.invalid)
+		error(formatString("Invalid type: \"%.*s\".",
+			parser.previous.length, parser.previous.start));
 
 	return type;
 }
@@ -546,7 +591,7 @@ ParseRule rules[] = {
 	// token				// prefix,  infix,  precedence
 	[TOKEN_LEFT_PAREN]    	= {grouping,call,   PREC_CALL},
 	[TOKEN_RIGHT_PAREN] 	= {NULL, 	NULL,   PREC_NONE},
-	[TOKEN_LEFT_BRACE] 		= {NULL,	NULL,   PREC_NONE},
+	[TOKEN_LEFT_BRACE] 		= {map, 	NULL,   PREC_NONE},
 	[TOKEN_RIGHT_BRACE] 	= {NULL, 	NULL,   PREC_NONE},
 	[TOKEN_LEFT_B_BRACE] 	= {array, 	index,  PREC_CALL},
 	[TOKEN_RIGHT_B_BRACE] 	= {NULL, 	NULL,   PREC_NONE},
@@ -575,6 +620,7 @@ ParseRule rules[] = {
 	[TOKEN_LESS_EQUAL] 		= {NULL, 	binary, PREC_COMPARISON},
 	[TOKEN_IDENTIFIER] 		= {variable,NULL,   PREC_NONE},
 	[TOKEN_STRING] 			= {string, 	NULL,   PREC_NONE},
+	[TOKEN_INTERPOLATION]	= {interpolation, NULL, PREC_NONE},
 	[TOKEN_NUMBER] 			= {number, 	NULL,   PREC_NONE},
 	[TOKEN_AND] 			= {NULL, 	and_, 	PREC_AND},
 	[TOKEN_CLASS] 			= {NULL, 	NULL,   PREC_NONE},
@@ -854,9 +900,7 @@ static void function(FunctionType type)
 
 	// accept return type
 	if (match(TOKEN_ARROW))
-		current->function->returnType = *dataType("Expect type after '->'.");
-	else
-		current->function->returnType = *newDataType(NULL_VAL, true);
+		current->function->returnType = dataType("Expect type after '->'.");
 
 	consume(TOKEN_LEFT_B_BRACE, "Expect '[' after function name.");
 
@@ -872,13 +916,14 @@ static void function(FunctionType type)
 			}
 			uint8_t constant = parseVariable("Expect parameter name.");
 
-			// accept parameter type
+			// accept parameter type, kept on the stack while the
+			// array grows
+			ObjDataType type = anyType();
 			if (match(TOKEN_COLON))
-				writeValueArray(&current->function->argTypes,
-					OBJ_VAL(dataType("Expect type after ':'.")));
-			else
-				writeValueArray(&current->function->argTypes,
-					OBJ_VAL(newDataType(NULL_VAL, true)));
+				type = dataType("Expect type after ':'.");
+			push(OBJ_VAL(heapType(&type)));
+			writeValueArray(&current->function->argTypes, vm.stackTop[-1]);
+			pop();
 
 			defineVariable(constant);
 
@@ -991,27 +1036,27 @@ static void varDeclaration()
 			"Cannot redeclare native variable '%.*s'.",
 			parser.previous.length, parser.previous.start));
 
-	ObjDataType *type = newDataType(NULL_VAL, true);
+	ObjDataType type = anyType();
 	bool hasType = false;
 
 	if (match(TOKEN_COLON))
 	{
 		type = dataType("Expect type after ':'.");
 		hasType = true;
-		current->locals[current->localCount - 1].type = *type;
+		current->locals[current->localCount - 1].type = type;
 	}
 
 	if (match(TOKEN_EQUAL))
 		expression();
 	else
-		emitDefaultValue(type);
+		emitDefaultValue(&type);
 
 	if (hasType)
 	{
 		char *msg = "Expected value of type %s, not %s.";
 		emitByte(OP_ASSERT_TYPE);
 		emitBytes(
-			addConstant(currentChunk(), OBJ_VAL(type)),
+			typeConstant(&type),
 			addConstant(currentChunk(), OBJ_VAL(copyString(msg, strlen(msg))))
 		);
 	}
@@ -1022,14 +1067,14 @@ static void varDeclaration()
 	// if it is a global it emitted OP_DEFINE_GLOBAL which expects a 3rd
 	// operand (the datatype) as well
 	if (current->scopeDepth == 0)
-		emitByte(addConstant(currentChunk(), OBJ_VAL(type)));
+		emitByte(typeConstant(&type));
 }
 
 // compiles a field declaration
 static void fieldDeclaration()
 {
 	uint8_t field = parseVariable("Expect variable name.");
-	ObjDataType *type = newDataType(NULL_VAL, true);
+	ObjDataType type = anyType();
 	bool hasType = false;
 
 	if (match(TOKEN_COLON))
@@ -1045,21 +1090,21 @@ static void fieldDeclaration()
 		defined = true;
 	}
 	else
-		emitDefaultValue(type);
+		emitDefaultValue(&type);
 
 	if (hasType && defined)
 	{
 		char *msg = "Expected value of type %s, not %s.";
 		emitByte(OP_ASSERT_TYPE);
 		emitBytes(
-			addConstant(currentChunk(), OBJ_VAL(type)),
+			typeConstant(&type),
 			addConstant(currentChunk(), OBJ_VAL(copyString(msg, strlen(msg)))));
 	}
 
 	consume(TOKEN_SEMICOLON, "Expect ';' after variable declaration.");
 
 	emitBytes(OP_DEFINE_FIELD, field);
-	emitByte(addConstant(currentChunk(), OBJ_VAL(type)));
+	emitByte(typeConstant(&type));
 }
 
 // compiles a class declaration
@@ -1077,8 +1122,10 @@ static void classDeclaration()
 	defineVariable(nameConstant);
 	// third arg for OP_DEFINE_GLOBAL
 	if (current->scopeDepth == 0)
-		emitByte(addConstant(currentChunk(),
-			OBJ_VAL(newDataType(OBJ_VAL(newClass(copyString("", 0))), false))));
+	{
+		ObjDataType type = objectType(OBJ_CLASS);
+		emitByte(typeConstant(&type));
+	}
 
 	// let the compiler know we're compiling a class
 	ClassCompiler classCompiler;
@@ -1145,8 +1192,8 @@ static void funDeclaration()
 	// operand (the datatype) as well
 	if (current->scopeDepth == 0)
 	{
-		ObjDataType *type = newDataType(OBJ_VAL(newFunction()), false);
-		emitByte(addConstant(currentChunk(), OBJ_VAL(type)));
+		ObjDataType type = objectType(OBJ_FUNCTION);
+		emitByte(typeConstant(&type));
 	}
 }
 
@@ -1419,7 +1466,8 @@ static void grouping(bool canAssign)
 // compiles a number
 static void number(bool canAssign)
 {
-	double value = strtod(parser.previous.start, NULL);
+	double value;
+	parseNumber(parser.previous.start, parser.previous.length, &value);
 	emitConstant(NUMBER_VAL(value));
 }
 
@@ -1436,10 +1484,32 @@ static void array(bool canAssign)
 	}
 	consume(TOKEN_RIGHT_B_BRACE, "Expect ']' after array.");
 
+	if (length > UINT8_MAX)
+		error("Can't have more than 255 values in an array literal.");
 	emitBytes(OP_ARRAY, (uint8_t)length);
 }
 
-// indexes an array
+// compiles a map literal like {key: value, ...}
+static void map(bool canAssign)
+{
+	int length = 0;
+	while (!check(TOKEN_RIGHT_BRACE) && !check(TOKEN_EOF))
+	{
+		expression();
+		consume(TOKEN_COLON, "Expect ':' after map key.");
+		expression();
+		if (!check(TOKEN_RIGHT_BRACE))
+			consume(TOKEN_COMMA, "Expect ',' between entries");
+		length++;
+	}
+	consume(TOKEN_RIGHT_BRACE, "Expect '}' after map.");
+
+	if (length > UINT8_MAX)
+		error("Can't have more than 255 entries in a map literal.");
+	emitBytes(OP_MAP, (uint8_t)length);
+}
+
+// indexes an array or map
 static void index(bool canAssign)
 {
 	expression();
@@ -1488,18 +1558,48 @@ static void string(bool canAssign)
 	emitConstant(OBJ_VAL(copyString(parser.previous.start + 1, parser.previous.length - 2)));
 }
 
+// compiles an interpolated string like "a${b}c". all parts are left on
+// the stack and joined by one OP_BUILD_STRING, so no intermediate
+// strings are created
+static void interpolation(bool canAssign)
+{
+	int parts = 0;
+	do
+	{
+		// the literal text in front of "${", without the leading '"' or '}'
+		if (parser.previous.length > 3)
+		{
+			emitConstant(OBJ_VAL(copyString(parser.previous.start + 1, parser.previous.length - 3)));
+			parts++;
+		}
+
+		expression();
+		parts++;
+	} while (match(TOKEN_INTERPOLATION));
+
+	consume(TOKEN_STRING, "Expect end of string after interpolation.");
+	if (parser.previous.length > 2)
+	{
+		emitConstant(OBJ_VAL(copyString(parser.previous.start + 1, parser.previous.length - 2)));
+		parts++;
+	}
+
+	if (parts > UINT8_MAX)
+		error("Can't have more than 255 parts in one string.");
+	emitBytes(OP_BUILD_STRING, (uint8_t)parts);
+}
+
 static void namedVariable(Token name, bool canAssign)
 {
 	uint8_t getOp, setOp;
 	int arg = resolveNativeVar(&name);
-	ObjDataType *type;
+	ObjDataType *type = NULL;
 	
 	// native var
 	if (arg != -1)
 	{
 		getOp = OP_GET_NVAR;
 		setOp = OP_SET_NVAR;
-		type = newDataType(NULL_VAL, true);
 	}
 	else if ((arg = resolveLocal(current, &name)) != -1)
 	{
@@ -1526,12 +1626,13 @@ static void namedVariable(Token name, bool canAssign)
 		expression();
 
 
+		// Any (and native variables) accept every value
 		const char *msg = "Expected value of type %s, not %s.";
-		if (setOp != OP_SET_GLOBAL)
+		if (type != NULL && !type->isAny)
 		{
 			emitByte(OP_ASSERT_TYPE);
 			emitBytes(
-				addConstant(currentChunk(), OBJ_VAL(type)),
+				typeConstant(type),
 				addConstant(currentChunk(), OBJ_VAL(copyString(msg, strlen(msg))))
 			);
 		}
@@ -1736,6 +1837,7 @@ static void initCompiler(Compiler *compiler, FunctionType type)
 	Local *local = &current->locals[current->localCount++];
 	local->depth = 0;
 	local->isCaptured = false;
+	local->type = anyType();
 	if (type != TYPE_FUNCTION)
 	{
 		// we're in a method so yea
@@ -1756,6 +1858,8 @@ static ObjFunction* endCompiler()
 	emitByte(OP_SCRIPT_END);
 
 	ObjFunction *function = current->function;
+	// no longer traced as a compiler root, see markCompilerRoots()
+	writeBarrier((Obj *)function);
 #ifdef DEBUG_PRINT_CODE
 	if (!parser.hadError)
 	{
@@ -1794,6 +1898,9 @@ static void endScope()
 // main compile function
 ObjFunction* compile(const char *source)
 {
+	// error messages and such are dropped once done
+	ScratchMark mark = scratchMark();
+	heapTypeCount = 0;
 	initScanner(source);
 	Compiler compiler;
 	initCompiler(&compiler, TYPE_SCRIPT);
@@ -1808,6 +1915,8 @@ ObjFunction* compile(const char *source)
 
 	// consume(TOKEN_EOF, "Expect end of expression.");
 	ObjFunction *function = endCompiler();
+	scratchReset(mark);
+	heapTypeCount = 0;
 	return parser.hadError ? NULL : function;
 }
 
@@ -1817,7 +1926,10 @@ void markCompilerRoots()
 	Compiler *compiler = current;
 	while (compiler != NULL)
 	{
-		markObject((Obj *)compiler->function);
+		// still being written to, so traced even when old
+		traceObject((Obj *)compiler->function);
 		compiler = compiler->enclosing;
 	}
+	for (int i = 0; i < heapTypeCount; i++)
+		markObject((Obj *)heapTypes[i]);
 }
@@ -107,10 +107,12 @@ int disassembleInstruction(Chunk *chunk, int offset)
     case OP_SET_INDEX:     return simpleInstruction("OP_SET_INDEX", offset);
     case OP_ARRAY_LENGTH:  return simpleInstruction("OP_ARRAY_LENGTH", offset);
     case OP_ARRAY:         return byteInstruction("OP_ARRAY", chunk, offset);
+    case OP_MAP:           return byteInstruction("OP_MAP", chunk, offset);
     case OP_EQUAL:         return simpleInstruction("OP_EQUAL", offset);
     case OP_GREATER:       return simpleInstruction("OP_GREATER", offset);
     case OP_LESS:          return simpleInstruction("OP_LESS", offset);
     case OP_ADD:           return simpleInstruction("OP_ADD", offset);
+    case OP_BUILD_STRING:  return byteInstruction("OP_BUILD_STRING", chunk, offset);
     case OP_INCREMENT:     return simpleInstruction("OP_INCREMENT", offset);
     case OP_SUBTRACT:      return simpleInstruction("OP_SUBTRACT", offset);
     case OP_DECREMENT:     return simpleInstruction("OP_DECREMENT", offset);
@@ -33,10 +33,12 @@ typedef enum
 	OP_SET_INDEX,
 	OP_ARRAY_LENGTH,
 	OP_ARRAY,
+	OP_MAP,
 	OP_EQUAL,
 	OP_GREATER,
 	OP_LESS,
 	OP_ADD,
+	OP_BUILD_STRING,
 	OP_INCREMENT,
 	OP_SUBTRACT,
 	OP_DECREMENT,
@@ -0,0 +1,126 @@
+#ifndef brace_hash_h
+#define brace_hash_h
+
+#include <string.h>
+
+#include "common.h"
+
+/*
+String hashing, based on wyhash (public domain, by Wang Yi).
+Keys are consumed 8 bytes at a time and every block is folded in
+with a 64x64->128 bit multiply, so even long strings (input lines,
+concatenation results) hash at several bytes per cycle. The final
+mix spreads entropy into the low bits, which is what findEntry()
+looks at when it masks the hash with (capacity - 1).
+*/
+
+static const uint64_t hashSecret[4] = {
+	0x2d358dccaa6c78a5ull, 0x8bb84b93962eacc9ull,
+	0x4b33a62ed433d4a3ull, 0x4d5a2da51de1aa47ull,
+};
+
+// hashMix(hashSecret[0], hashSecret[1]), the fixed starting seed
+#define HASH_SEED 0xca813bf4c7abf0a9ull
+
+// multiplies a and b and stores the low and high halves in them
+static inline void hashMum(uint64_t *a, uint64_t *b)
+{
+#ifdef __SIZEOF_INT128__
+	__uint128_t r = (__uint128_t)*a * *b;
+	*a = (uint64_t)r;
+	*b = (uint64_t)(r >> 64);
+#else
+	uint64_t ha = *a >> 32, hb = *b >> 32;
+	uint64_t la = (uint32_t)*a, lb = (uint32_t)*b;
+	uint64_t rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb;
+	uint64_t t = rl + (rm0 << 32);
+	uint64_t c = t < rl;
+	uint64_t lo = t + (rm1 << 32);
+	c += lo < t;
+	*a = lo;
+	*b = rh + (rm0 >> 32) + (rm1 >> 32) + c;
+#endif
+}
+
+static inline uint64_t hashMix(uint64_t a, uint64_t b)
+{
+	hashMum(&a, &b);
+	return a ^ b;
+}
+
+static inline uint64_t hashRead8(const uint8_t *p)
+{
+	uint64_t v;
+	memcpy(&v, p, 8);
+	return v;
+}
+
+static inline uint64_t hashRead4(const uint8_t *p)
+{
+	uint32_t v;
+	memcpy(&v, p, 4);
+	return v;
+}
+
+// reads 1 to 3 bytes
+static inline uint64_t hashRead3(const uint8_t *p, size_t k)
+{
+	return (((uint64_t)p[0]) << 16) | (((uint64_t)p[k >> 1]) << 8) | p[k - 1];
+}
+
+static inline uint32_t hashString(const char *key, int length)
+{
+	const uint8_t *p = (const uint8_t *)key;
+	size_t len = (size_t)length;
+	uint64_t seed = HASH_SEED;
+	uint64_t a, b;
+
+	if (len <= 16)
+	{
+		if (len >= 4)
+		{
+			a = (hashRead4(p) << 32) | hashRead4(p + ((len >> 3) << 2));
+			b = (hashRead4(p + len - 4) << 32) |
+				hashRead4(p + len - 4 - ((len >> 3) << 2));
+		}
+		else if (len > 0)
+		{
+			a = hashRead3(p, len);
+			b = 0;
+		}
+		else
+			a = b = 0;
+	}
+	else
+	{
+		size_t i = len;
+		if (i > 48)
+		{
+			uint64_t see1 = seed, see2 = seed;
+			do
+			{
+				seed = hashMix(hashRead8(p) ^ hashSecret[1], hashRead8(p + 8) ^ seed);
+				see1 = hashMix(hashRead8(p + 16) ^ hashSecret[2], hashRead8(p + 24) ^ see1);
+				see2 = hashMix(hashRead8(p + 32) ^ hashSecret[3], hashRead8(p + 40) ^ see2);
+				p += 48;
+				i -= 48;
+			} while (i > 48);
+			seed ^= see1 ^ see2;
+		}
+		while (i > 16)
+		{
+			seed = hashMix(hashRead8(p) ^ hashSecret[1], hashRead8(p + 8) ^ seed);
+			i -= 16;
+			p += 16;
+		}
+		a = hashRead8(p + i - 16);
+		b = hashRead8(p + i - 8);
+	}
+
+	a ^= hashSecret[1];
+	b ^= seed;
+	hashMum(&a, &b);
+	return (uint32_t)hashMix(a ^ hashSecret[0] ^ len, b ^ hashSecret[1]);
+}
+
+#endif // !brace_hash_h
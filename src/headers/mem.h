@@ -1,12 +1,65 @@
 #ifndef brace_memory_h
 #define brace_memory_h
 
+#include <stdio.h>
+
 #include "common.h"
 #include "object.h"
+#include "vm.h"
+
+// marks stay set after a collection: a marked object is old. a full
+// collection flips vm.markBit, which unmarks every object at once
+#define IS_MARKED(object) ((object)->mark == vm.markBit)
+
+// default work of one incremental collection step, counted in
+// references traced or objects swept
+#ifdef DEBUG_STRESS_GC
+#define GC_STEP_WORK 16
+#else
+#define GC_STEP_WORK 4096
+#endif
+
+// most threads a full collection traces on, see vm.gcThreads
+#define GC_MAX_THREADS 16
 
 void collectGarbage();
+size_t compactHeap();
+int defaultGcThreads();
+void printGcStats(FILE *file);
 void markValue(Value value);
 void markObject(Obj *object);
+void traceObject(Obj *object);
+void rememberObject(Obj *object);
+Obj *forwardObject(Obj *object);
+void forwardValue(Value *value);
+
+// call after storing a reference into object. an old object may now
+// point to young ones, so minor collections have to trace it too.
+// while an incremental collection marks, it keeps black objects from
+// pointing to white ones unnoticed
+static inline void writeBarrier(Obj *object)
+{
+    if (IS_MARKED(object) && !object->isRemembered)
+        rememberObject(object);
+}
+
+// cheaper for a single value stored into a possibly large object: the
+// young value itself is remembered as a root for the next minor
+// collection, so the object does not have to be rescanned
+static inline void writeValueBarrier(Obj *object, Value value)
+{
+    if (IS_MARKED(object) && IS_OBJ(value) && !IS_MARKED(AS_OBJ(value)) &&
+        !AS_OBJ(value)->isRemembered)
+        rememberObject(AS_OBJ(value));
+}
+
+// call after moving the elements of an array around. a collection
+// step that is part way through it has to start over
+static inline void arrayMoveBarrier(ObjArray *array)
+{
+    if (vm.scanArray == array)
+        vm.scanIndex = 0;
+}
 
 // allocates memory for type of size count
 #define ALLOCATE(type, count) \
@@ -27,9 +80,35 @@ void markObject(Obj *object);
 #define GROW_ARRAY(type, pointer, oldCount, newCount)      \
     (type *)reallocate(pointer, sizeof(type) * (oldCount), sizeof(type) * (newCount))
 
+// frees an object allocated with allocateObjectMemory()
+#define FREE_OBJ(type, pointer) freeObjectMemory(pointer, sizeof(type))
+
 void *reallocate(void *pointer, size_t oldSize, size_t newSize);
+void *allocateObjectMemory(size_t size);
+void freeObjectMemory(void *pointer, size_t size);
 void freeObjects();
+
+// scratch memory for short lived text, like formatString() results.
+// the VM drops it between instructions, see scratchClear(), so it must
+// be used or copied before the instruction is done
+typedef struct
+{
+    struct ScratchChunk *chunk;
+    size_t used;
+} ScratchMark;
+
+void *scratchAllocate(size_t size);
+ScratchMark scratchMark();
+void scratchReset(ScratchMark mark);
+void freeScratch();
 char *formatString(const char *format, ...);
+
+// frees all scratch memory, cheap when there is none
+static inline void scratchClear()
+{
+    if (vm.scratch != NULL)
+        scratchReset((ScratchMark){NULL, 0});
+}
 // void freeObject(Obj *object);
 
 #endif
\ No newline at end of file
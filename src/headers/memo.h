@@ -0,0 +1,24 @@
+#ifndef brace_memo_h
+#define brace_memo_h
+
+#include "common.h"
+#include "object.h"
+
+/*
+Result cache of a function wrapped by Memoize(). Arguments are
+compared the way map keys are: numbers, bools and strings by value,
+other objects by identity.
+A call that misses reserves a pending entry for its arguments, and
+the call's frame fills it in when it returns. Entries carry a stamp,
+so a frame never writes into an entry that was dropped and reused
+meanwhile. With a size bound the least recently used entry makes room
+for a new one. Pending entries are never evicted.
+*/
+
+bool memoLookup(ObjMemo *memo, Value *args, Value *result, int *entry);
+void memoStore(ObjMemo *memo, int entry, uint32_t stamp, Value result);
+void markMemo(ObjMemo *memo);
+void forwardMemo(ObjMemo *memo);
+void freeMemo(ObjMemo *memo);
+
+#endif // !brace_memo_h
@@ -19,9 +19,11 @@ argCount and arity variables are
 incremented once.
 */
 
-ValueArray numberMethods;
-ValueArray stringMethods;
-ValueArray arrayMethods;
+extern ValueArray numberMethods;
+extern ValueArray stringMethods;
+extern ValueArray arrayMethods;
+extern ValueArray stringBuilderMethods;
+extern ValueArray mapMethods;
 
 void defineAllMethods();
 
@@ -0,0 +1,18 @@
+#ifndef brace_number_h
+#define brace_number_h
+
+#include "common.h"
+
+// enough room for any number formatNumber() writes, plus the terminator
+#define NUMBER_BUFFER_SIZE 32
+
+// writes the shortest text that reads back as exactly the same double
+// into buffer (at least NUMBER_BUFFER_SIZE bytes) and returns its length
+int formatNumber(double value, char *buffer);
+
+// parses a decimal number (optional sign, fraction and exponent) that
+// makes up all of chars except surrounding whitespace into value.
+// returns false if chars is not such a number
+bool parseNumber(const char *chars, int length, double *value);
+
+#endif // !brace_number_h
@@ -6,6 +6,9 @@
 #include "chunk.h"
 #include "table.h"
 
+// strings up to this length are preallocated and shared
+#define SHORT_STRING_MAX 1
+
 #define OBJ_TYPE(value) (AS_OBJ(value)->type)
 
 #define IS_BOUND_METHOD(value) isObjType(value, OBJ_BOUND_METHOD)
@@ -19,6 +22,9 @@
 #define IS_ARRAY(value) isObjType(value, OBJ_ARRAY)
 #define IS_DATA_TYPE(value) isObjType(value, OBJ_DATA_TYPE)
 #define IS_MODULE(value) isObjType(value, OBJ_MODULE)
+#define IS_STRING_BUILDER(value) isObjType(value, OBJ_STRING_BUILDER)
+#define IS_MAP(value) isObjType(value, OBJ_MAP)
+#define IS_MEMO(value) isObjType(value, OBJ_MEMO)
 
 #define AS_BOUND_METHOD(value) ((ObjBoundMethod *)AS_OBJ(value))
 #define AS_CLASS(value) ((ObjClass *)AS_OBJ(value))
@@ -32,6 +38,9 @@
 #define AS_ARRAY(value) ((ObjArray *)AS_OBJ(value))
 #define AS_DATA_TYPE(value) ((ObjDataType *)AS_OBJ(value))
 #define AS_MODULE(value) ((ObjModule *)AS_OBJ(value))
+#define AS_STRING_BUILDER(value) ((ObjStringBuilder *)AS_OBJ(value))
+#define AS_MAP(value) ((ObjMap *)AS_OBJ(value))
+#define AS_MEMO(value) ((ObjMemo *)AS_OBJ(value))
 
 typedef enum
 {
@@ -46,13 +55,19 @@ typedef enum
 	OBJ_STRING,
 	OBJ_UPVALUE,
 	OBJ_DATA_TYPE,
-	OBJ_MODULE
+	OBJ_MODULE,
+	OBJ_STRING_BUILDER,
+	OBJ_MAP,
+	OBJ_MEMO
 } ObjType;
 
+#define OBJ_TYPE_COUNT (OBJ_MEMO + 1)
+
 struct Obj
 {
 	ObjType type;
-	bool isMarked;
+	bool mark;         // marked when equal to vm.markBit, see IS_MARKED()
+	bool isRemembered; // in vm.remembered until the next collection
 	struct Obj* next;
 };
 
@@ -116,8 +131,10 @@ struct ObjString
 {
 	Obj obj;
 	int length;
-	char *chars;
 	uint32_t hash;
+	bool isHashed;   // hash is computed lazily for uninterned strings
+	bool isInterned; // interned strings live in vm.strings
+	char chars[];    // stored inline, right after the header
 };
 
 typedef struct ObjUpvalue
@@ -162,12 +179,61 @@ typedef struct
 typedef struct
 {
 	Obj obj;
-	ObjString name;
-	ObjString path;
+	ObjString *name;
+	ObjString *path;
 	Table fields;
 	Table fieldsTypes;
 } ObjModule;
 
+typedef struct
+{
+	Obj obj;
+	// a block shaped like an ObjString: header space, then the text.
+	// ToStr() turns it into a string without copying the text
+	ObjString *buffer;
+	int length;
+	int capacity; // room for text, not counting header and terminator
+	// result of the last ToStr() while nothing was appended since.
+	// it owns the old buffer, so the next append copies the text out
+	ObjString *string;
+} ObjStringBuilder;
+
+typedef struct
+{
+	Obj obj;
+	ValueTable table;
+} ObjMap;
+
+typedef struct
+{
+	uint32_t hash;  // of the arguments
+	uint32_t stamp; // tells a call which entry is still its own
+	bool pending;   // the call has not returned yet
+	int newer;      // least recently used list, -1 at both ends
+	int older;
+	Value result;
+} MemoEntry;
+
+// a function wrapped by Memoize(). each entry holds the arguments of
+// one call (arity values in keys) and what it returned, found through
+// slots, a linear probing index of entry numbers
+typedef struct
+{
+	Obj obj;
+	ObjClosure *closure;
+	int arity;
+	int maxEntries; // 0 for no limit
+	int count;
+	int capacity;
+	MemoEntry *entries;
+	Value *keys;
+	int *slots;      // -1 for an empty slot
+	int slotCapacity; // a power of two, at least twice capacity
+	int newest;
+	int oldest;
+	uint32_t stamp; // of the last entry handed out
+} ObjMemo;
+
 ObjBoundMethod *newBoundMethod(Value receiver, ObjClosure *method);
 ObjBoundNativeMethod *newBoundNativeMethod(Value receiver, ObjNative *native);
 ObjClass *newClass(ObjString *name);
@@ -180,11 +246,31 @@ ObjUpvalue *newUpvalue(Value *slot);
 ObjArray *newArray();
 ObjDataType *newDataType(Value value, bool isAny);
 Value callDataType(ObjDataType *callee, int argCount, Value *args);
-ObjDataType *dataTypeFromString(const char *str);
+ObjDataType anyType();
+ObjDataType objectType(ObjType objType);
+ObjDataType dataTypeFromString(const char *chars, int length);
 ObjModule *newModule(const char *name, const char *path);
+void initShortStrings();
+ObjString *allocateString(int length);
 ObjString *takeString(char *chars, int length);
 ObjString *copyString(const char *chars, int length);
+ObjString *takeUninternedString(char *chars, int length);
+ObjString *copyUninternedString(const char *chars, int length);
+ObjString *internString(ObjString *string);
+ObjString *findInternedString(ObjString *string);
+uint32_t stringHash(ObjString *string);
+bool stringsEqual(ObjString *a, ObjString *b);
+ObjStringBuilder *newStringBuilder();
+bool stringBuilderReserve(ObjStringBuilder *builder, int extra);
+bool stringBuilderAppend(ObjStringBuilder *builder, const char *chars, int length);
+bool stringBuilderAppendValue(ObjStringBuilder *builder, Value value);
+ObjString *stringBuilderToString(ObjStringBuilder *builder);
+ObjMap *newMap();
+ObjArray *mapKeys(ObjMap *map);
+ObjArray *mapValues(ObjMap *map);
+ObjMemo *newMemo(ObjClosure *closure, int maxEntries);
 char *objectToString(Value value);
+const char *objTypeName(ObjType type);
 void printObject(Value value);
 // checks wether the given Value is of ObjType type
 static inline bool isObjType(Value value, ObjType type)
@@ -40,6 +40,7 @@ typedef enum
 	// Literals.
 	TOKEN_IDENTIFIER,
 	TOKEN_STRING,
+	TOKEN_INTERPOLATION, // string part in front of a "${"
 	TOKEN_NUMBER,
 
 	// Keywords.
@@ -0,0 +1,37 @@
+#ifndef brace_slab_h
+#define brace_slab_h
+
+#include "common.h"
+
+/*
+Size-class allocator for small objects. Blocks are rounded up to a
+multiple of 16 bytes and every size class carves them out of its own
+64 KB pages, so objects of one type sit next to each other instead of
+being scattered across the malloc heap. Freed blocks go onto the free
+list of their class and are handed out again first.
+Pages are aligned to their size and mapped straight from the OS, so
+compaction can move the live blocks out of sparse pages and unmap them.
+Nothing here is thread safe except slabDefer(), which the sweeper
+thread uses while the program allocates.
+*/
+
+// objects of up to this many bytes come from slabs
+#define SLAB_MAX_SIZE 128
+
+void *slabAllocate(size_t size);
+void slabFree(void *pointer, size_t size);
+// frees without touching the free lists, see slabReclaim()
+void slabDefer(void *pointer, size_t size);
+// makes the blocks given to slabDefer() available again
+void slabReclaim();
+void freeSlabs();
+
+// compaction, driven by compactHeap()
+bool slabFragmented();
+void slabBeginCompaction();
+void slabMarkLive(void *pointer);
+bool slabPlanCompaction();
+bool slabEvacuating(void *pointer);
+size_t slabEndCompaction();
+
+#endif // !brace_slab_h
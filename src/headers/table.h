@@ -4,17 +4,24 @@
 #include "common.h"
 #include "value.h"
 
+/*
+Swiss-table style layout: every slot has a control byte that is
+either empty, deleted, or holds 7 bits of the key's hash. Lookups
+compare the control bytes of 16 slots at once and only look at the
+keys whose bits match. Keys and values live in parallel arrays, all
+three sharing one allocation.
+Small tables (up to 8 slots, most fields and methods) have no control
+bytes: their entries are packed at the front and found by comparing
+key pointers one by one.
+*/
 typedef struct
 {
-    ObjString *key;
-    Value value;
-} Entry;
-
-typedef struct
-{
-    int count;
-    int capacity;
-    Entry *entries;
+    int count;      // live entries
+    int tombstones; // deleted slots that still lengthen probes
+    int capacity;   // number of slots, 0, 2, 4, 8 or a multiple of 16
+    int8_t *ctrl;   // NULL while the table is linear
+    ObjString **keys;
+    Value *values;
 } Table;
 
 void initTable(Table *table);
@@ -22,9 +29,32 @@ void freeTable(Table *table);
 bool tableGet(Table *table, ObjString *key, Value *value);
 bool tableSet(Table *table, ObjString *key, Value value);
 bool tableDelete(Table *table, ObjString *key);
+bool tableCompact(Table *table);
 void tableAddAll(Table *from, Table *to);
 ObjString *tableFindString(Table *table, const char *chars,
                            int length, uint32_t hash);
 void tableRemoveWhite(Table *table);
 void markTable(Table *table);
+void forwardTable(Table *table);
+
+// a hashed table keyed by any value, for script maps
+typedef struct
+{
+    int count;
+    int tombstones;
+    int capacity; // 0 or a multiple of 16
+    int8_t *ctrl;
+    Value *keys;
+    Value *values;
+} ValueTable;
+
+void initValueTable(ValueTable *table);
+void freeValueTable(ValueTable *table);
+bool valueTableGet(ValueTable *table, Value key, Value *value);
+bool valueTableSet(ValueTable *table, Value key, Value value);
+bool valueTableDelete(ValueTable *table, Value key);
+bool valueTableEntry(ValueTable *table, int index, Value *key, Value *value);
+void markValueTable(ValueTable *table);
+void forwardValueTable(ValueTable *table);
+uint32_t hashValue(Value value);
 #endif
\ No newline at end of file
@@ -1,6 +1,8 @@
 #ifndef brace_vm_h
 #define brace_vm_h
 
+#include <setjmp.h>
+
 #include "object.h"
 #include "table.h"
 #include "value.h"
@@ -13,8 +15,43 @@ typedef struct
 	ObjClosure *closure;
 	uint8_t *ip;
 	Value *slots;
+	// Memoize() entry the call fills in, -1 for none. the ObjMemo
+	// itself stays in slot 0
+	int memoEntry;
+	uint32_t memoStamp;
 } CallFrame;
 
+// state of an incremental full collection
+typedef enum
+{
+	GC_IDLE,
+	GC_MARK,
+	GC_SWEEP,
+} GcPhase;
+
+// heap sizing, set with --gc-* flags or BRACE_GC_* variables
+typedef struct
+{
+	size_t initialHeap; // where the first full collection starts
+	double growFactor;  // the next starts at live bytes * growFactor
+	size_t minInterval; // bytes allocated between two, at least
+	size_t maxInterval; // and at most, 0 for no limit
+	size_t maxHeap;     // hard cap, 0 for none
+	bool compact;       // compact when slab pages are sparsely used
+} HeapPolicy;
+
+// counters behind GcStats() and --gc-stats
+typedef struct
+{
+	int minorCollections;
+	int fullCollections; // finished cycles, incremental or not
+	int steps;           // incremental steps
+	double pauseTotal;   // seconds the program waited for the GC
+	double pauseMax;
+	size_t bytesFreed;
+	size_t typeBytes[OBJ_TYPE_COUNT]; // live object bytes by ObjType
+} GcStats;
+
 typedef struct
 {
 	CallFrame frames[FRAMES_MAX];
@@ -31,11 +68,35 @@ typedef struct
 
 	size_t bytesAllocated;
 	size_t nextGC;
-	Obj *objects;
+	size_t youngBytes; // allocated since the last collection
+	bool collecting;   // no collection may start while true
+	bool markBit;      // Obj.mark of marked objects
+	Obj *objects;      // old generation: survived a collection
+	Obj *youngObjects; // allocated since the last collection
 	
 	int grayCount;
 	int grayCapacity;
 	Obj **grayStack;
+
+	// old objects written to since the last collection, and young
+	// objects stored into old ones
+	int rememberedCount;
+	int rememberedCapacity;
+	Obj **remembered;
+
+	// incremental full collections
+	GcPhase gcPhase;
+	size_t stepBytes;  // allocated since the last step
+	size_t stepWork;   // work budget of a step, see GC_STEP_WORK
+	ObjArray *scanArray; // big array being traced a slice at a time
+	int scanIndex;       // where the next slice of it starts
+	int gcThreads;       // markers of a big full collection
+	GcStats gcStats;
+	HeapPolicy heapPolicy;
+	jmp_buf *heapJump; // where hitting the heap cap unwinds to
+	bool compactPending; // compactHeap() at the next backward jump
+	struct ScratchChunk *scratch;      // see formatString()
+	struct ScratchChunk *scratchSpare; // empty chunk kept for reuse
 } VM;
 
 typedef enum
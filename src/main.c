@@ -1,3 +1,6 @@
+#include <ctype.h>
+#include <errno.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -203,27 +206,146 @@ static void runFile(const char *path)
 		exit(70);
 }
 
+// heap policy settings: the flag, the environment variable, and the
+// HeapPolicy field they set. flags win over the environment
+static const struct
+{
+	const char *flag;
+	const char *env;
+	size_t *size;   // sizes in bytes, optionally suffixed K, M or G
+	double *factor;
+} heapOptions[] = {
+	{"--gc-initial=", "BRACE_GC_INITIAL", &vm.heapPolicy.initialHeap, NULL},
+	{"--gc-grow=", "BRACE_GC_GROW", NULL, &vm.heapPolicy.growFactor},
+	{"--gc-min-interval=", "BRACE_GC_MIN_INTERVAL", &vm.heapPolicy.minInterval, NULL},
+	{"--gc-max-interval=", "BRACE_GC_MAX_INTERVAL", &vm.heapPolicy.maxInterval, NULL},
+	{"--heap-max=", "BRACE_HEAP_MAX", &vm.heapPolicy.maxHeap, NULL},
+};
+
+#define HEAP_OPTION_COUNT (int)(sizeof(heapOptions) / sizeof(heapOptions[0]))
+
+// sets heap option i from text, exits if it is malformed
+static void setHeapOption(int i, const char *text)
+{
+	char *end;
+	if (heapOptions[i].factor != NULL)
+	{
+		double factor = strtod(text, &end);
+		if (*end == '\0' && factor > 1)
+		{
+			*heapOptions[i].factor = factor;
+			return;
+		}
+	}
+	// strtoull() would take a sign and wrap negative sizes around
+	else if (isdigit((unsigned char)text[0]))
+	{
+		errno = 0;
+		unsigned long long size = strtoull(text, &end, 10);
+		unsigned long long unit = 1;
+		switch (*end)
+		{
+		case 'G': unit *= 1024; // fallthrough
+		case 'M': unit *= 1024; // fallthrough
+		case 'K': unit *= 1024; end++; break;
+		}
+		if (*end == '\0' && errno != ERANGE && size <= SIZE_MAX / unit)
+		{
+			*heapOptions[i].size = (size_t)(size * unit);
+			return;
+		}
+	}
+	fprintf(stderr, "Invalid value \"%s\" for %s.\n", text, heapOptions[i].env);
+	exit(64);
+}
+
+// set by --gc-stats
+static bool showGcStats = false;
+
+// prints the GC summary once, also when the program exits early
+static void printGcStatsAtExit()
+{
+	if (!showGcStats)
+		return;
+	showGcStats = false;
+	printGcStats(stderr);
+}
+
 int main(int argc, const char *argv[])
 {
 	// bool debug = false;
 
 	initVM(false);
 
-	// handle command line args
-	if (argc == 1)
+	for (int i = 0; i < HEAP_OPTION_COUNT; i++)
 	{
-		repl();
+		const char *value = getenv(heapOptions[i].env);
+		if (value != NULL)
+			setHeapOption(i, value);
 	}
-	else if (argc == 2)
+
+	// handle command line args
+	const char *path = NULL;
+	for (int i = 1; i < argc; i++)
 	{
-		runFile(argv[1]);
+		int option = 0;
+		while (option < HEAP_OPTION_COUNT && strncmp(argv[i], heapOptions[option].flag,
+			strlen(heapOptions[option].flag)) != 0)
+			option++;
+
+		// heap policy, see heapOptions
+		if (option < HEAP_OPTION_COUNT)
+			setHeapOption(option, argv[i] + strlen(heapOptions[option].flag));
+		// work per incremental GC step, see GC_STEP_WORK
+		else if (strncmp(argv[i], "--gc-step=", 10) == 0)
+		{
+			char *end;
+			long work = strtol(argv[i] + 10, &end, 10);
+			if (*end != '\0' || work <= 0)
+			{
+				fprintf(stderr, "Invalid GC step work \"%s\".\n", argv[i] + 10);
+				exit(64);
+			}
+			vm.stepWork = (size_t)work;
+		}
+		// threads tracing big heaps, see GC_MAX_THREADS
+		else if (strncmp(argv[i], "--gc-threads=", 13) == 0)
+		{
+			char *end;
+			long threads = strtol(argv[i] + 13, &end, 10);
+			if (*end != '\0' || threads < 1 || threads > GC_MAX_THREADS)
+			{
+				fprintf(stderr, "Invalid GC thread count \"%s\".\n", argv[i] + 13);
+				exit(64);
+			}
+			vm.gcThreads = (int)threads;
+		}
+		else if (strcmp(argv[i], "--gc-stats") == 0)
+			showGcStats = true;
+		// compact sparse slab pages, see compactHeap()
+		else if (strcmp(argv[i], "--gc-compact") == 0)
+			vm.heapPolicy.compact = true;
+		else if (path == NULL)
+			path = argv[i];
+		else
+		{
+			fprintf(stderr, "Usage: brace [--gc-step=work] [--gc-threads=count] [--gc-stats]\n"
+				"             [--gc-compact] [--gc-initial=size] [--gc-grow=factor]\n"
+				"             [--gc-min-interval=size] [--gc-max-interval=size]\n"
+				"             [--heap-max=size] [path]\n");
+			exit(64);
+		}
 	}
+
+	vm.nextGC = vm.heapPolicy.initialHeap;
+	atexit(printGcStatsAtExit);
+
+	if (path == NULL)
+		repl();
 	else
-	{
-		fprintf(stderr, "Usage: brace [path]\n");
-		exit(64);
-	}
+		runFile(path);
 
+	printGcStatsAtExit(); // before freeVM() empties the heap
 	freeVM();
 	return 0;
 }
\ No newline at end of file
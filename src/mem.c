@@ -1,3 +1,5 @@
+#define _POSIX_C_SOURCE 200809L // clock_gettime()
+
 #ifdef __INTELLISENSE__
 #pragma diag_suppress 29
 #pragma diag_suppress 254
@@ -6,6 +8,14 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <stdarg.h>
+#include <string.h>
+#include <time.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <unistd.h>
+#ifdef __GLIBC__
+#include <malloc.h> // malloc_trim()
+#endif
 
 #include "mem.h"
 #include "object.h"
@@ -15,37 +25,163 @@
 #include "debug.h"
 #endif
 #include "compiler.h"
+#include "methods.h"
+#include "memo.h"
+#include "slab.h"
+
+// an incremental collection that fell behind this far past nextGC is
+// finished in one go
+#define GC_BACKSTOP_FACTOR 2
+
+// bytes allocated between two minor collections
+#define GC_NURSERY_SIZE (512 * 1024)
 
-#define GC_HEAP_GROW_FACTOR 2
+// bytes allocated between two steps of an incremental collection
+#define GC_STEP_SIZE (16 * 1024)
+
+// heap size from which full collections trace on several threads
+#ifdef DEBUG_STRESS_GC
+#define GC_PARALLEL_HEAP 0
+#else
+#define GC_PARALLEL_HEAP (64 * 1024 * 1024)
+#endif
 
 // ------------------- GC ---------------------
 static void freeObject(Obj *object);
 void freeObjects();
 
+// the sweeper thread frees the garbage of a full collection while
+// the program goes on. it owns the objects handed to it until
+// finishSweep() joins it: unmarked ones are unreachable, and the
+// program never writes the mark or next of the marked ones, so
+// nothing is shared but done and freedBytes. memory is back in
+// malloc() only once free() returned, and slab blocks only once the
+// sweeper is joined, so it is never handed out while still being freed
+static struct
+{
+    pthread_t thread;
+    bool running;     // started and not joined yet
+    Obj *lists[2];    // objects to sweep
+    bool markBit;     // vm.markBit of the swept cycle
+    Obj *survivors;   // the marked objects of lists
+    Obj **tail;       // next link of the last survivor
+    size_t typeBytes[OBJ_TYPE_COUNT]; // freed, for vm.gcStats
+    atomic_bool done;
+} sweeper;
+
+// bytes freed by the sweeper not yet taken off vm.bytesAllocated
+static atomic_size_t freedBytes = 0;
+
+// true on the sweeper thread
+static _Thread_local bool onSweeper = false;
+
+// references traced so far, the unit of a marking step's budget
+static _Thread_local size_t work = 0;
+
+// a thread tracing part of the heap in traceParallel()
+typedef struct
+{
+    pthread_t thread;
+    int count;
+    int capacity;
+    Obj **stack; // gray objects of this thread
+} Marker;
+
+// this thread's Marker while tracing in parallel, else NULL and the
+// gray objects go onto vm.grayStack
+static _Thread_local Marker *marker = NULL;
+
+static void pushMarker(Marker *m, Obj *object)
+{
+    if (m->capacity < m->count + 1)
+    {
+        m->capacity = GROW_CAPACITY(m->capacity);
+        m->stack = (Obj **)realloc(m->stack, sizeof(Obj *) * m->capacity);
+
+        // allocation failed
+        if (m->stack == NULL)
+            exit(1);
+    }
+
+    m->stack[m->count++] = object;
+}
+
+// queues object to have its references marked
+static void grayObject(Obj *object)
+{
+    if (marker != NULL)
+    {
+        pushMarker(marker, object);
+        return;
+    }
+
+    if (vm.grayCapacity < vm.grayCount + 1)
+    {
+        vm.grayCapacity = GROW_CAPACITY(vm.grayCapacity);
+        vm.grayStack = (Obj **)realloc(vm.grayStack, sizeof(Obj *) * vm.grayCapacity);
+
+        // allocation failed
+        if (vm.grayStack == NULL)
+            exit(1);
+    }
+
+    vm.grayStack[vm.grayCount++] = object;
+}
+
+// marks are sticky: an object marked by an earlier collection is old
+// and a minor collection stops there
 void markObject(Obj *object)
 {
     if (object == NULL)
         return;
-    if (object->isMarked)
+    work++;
+    if (marker != NULL)
+    {
+        // other markers race for the same objects, only the one that
+        // sets the mark grays it
+        if (__atomic_load_n(&object->mark, __ATOMIC_RELAXED) == vm.markBit ||
+            __atomic_exchange_n(&object->mark, vm.markBit, __ATOMIC_RELAXED) == vm.markBit)
+            return;
+        grayObject(object);
+        return;
+    }
+    if (IS_MARKED(object))
         return;
     #ifdef DEBUG_LOG_GC
         printf("%p mark ", (void *)object);
         printValue(OBJ_VAL(object));
         printf("\n");
     #endif
-    object->isMarked = true;
+    object->mark = vm.markBit;
+    grayObject(object);
+}
 
-    if (vm.grayCapacity < vm.grayCount + 1)
+// marks object and its references even if it is old. for roots that
+// are still being filled in, like functions being compiled
+void traceObject(Obj *object)
+{
+    if (IS_MARKED(object))
+        grayObject(object);
+    else
+        markObject(object);
+}
+
+// adds an object to the remembered set, see writeBarrier() and
+// writeValueBarrier()
+void rememberObject(Obj *object)
+{
+    if (vm.rememberedCapacity < vm.rememberedCount + 1)
     {
-        vm.grayCapacity = GROW_CAPACITY(vm.grayCapacity);
-        vm.grayStack = (Obj **)realloc(vm.grayStack, sizeof(Obj *) * vm.grayCapacity);
+        vm.rememberedCapacity = GROW_CAPACITY(vm.rememberedCapacity);
+        vm.remembered = (Obj **)realloc(vm.remembered, sizeof(Obj *) * vm.rememberedCapacity);
 
         // allocation failed
-        if (vm.grayStack == NULL)
+        if (vm.remembered == NULL)
             exit(1);
     }
 
-    vm.grayStack[vm.grayCount++] = object;
+    object->isRemembered = true;
+    vm.remembered[vm.rememberedCount++] = object;
 }
 
 void markValue(Value value)
@@ -82,6 +218,8 @@ static void blackenObject(Obj *object)
     {
         ObjClass *klass = (ObjClass *)object;
         markTable(&klass->methods);
+        markTable(&klass->fields);
+        markTable(&klass->fieldsTypes);
         markObject((Obj *)klass->name);
         break;
     }
@@ -105,6 +243,8 @@ static void blackenObject(Obj *object)
         ObjFunction *function = (ObjFunction *)object;
         markObject((Obj *)function->name);
         markArray(&function->chunk.constants);
+        markArray(&function->argTypes);
+        markObject((Obj *)function->returnType.classType.name);
         break;
     }
     case OBJ_INSTANCE:
@@ -112,6 +252,7 @@ static void blackenObject(Obj *object)
         ObjInstance *instance = (ObjInstance *)object;
         markObject((Obj *)instance->klass);
         markTable(&instance->fields);
+        markTable(&instance->fieldsTypes);
         break;
     }
     case OBJ_ARRAY:
@@ -124,6 +265,7 @@ static void blackenObject(Obj *object)
     {
         ObjBoundNativeMethod *method = (ObjBoundNativeMethod *)object;
         markValue(method->receiver);
+        markObject((Obj *)method->native);
         break;
     }
     case OBJ_MODULE:
@@ -131,12 +273,39 @@ static void blackenObject(Obj *object)
         ObjModule *module = (ObjModule *)object;
         markTable(&module->fields);
         markTable(&module->fieldsTypes);
-        markObject((Obj *)&module->name);
-        markObject((Obj *)&module->path);
+        markObject((Obj *)module->name);
+        markObject((Obj *)module->path);
+        break;
+    }
+    case OBJ_STRING_BUILDER:
+    {
+        ObjStringBuilder *builder = (ObjStringBuilder *)object;
+        markObject((Obj *)builder->string);
+        break;
+    }
+    case OBJ_MAP:
+    {
+        markValueTable(&((ObjMap *)object)->table);
+        break;
+    }
+    case OBJ_MEMO:
+    {
+        markMemo((ObjMemo *)object);
         break;
     }
-    case OBJ_DATA_TYPE:
     case OBJ_NATIVE:
+    {
+        // method names are not kept alive by any table
+        ObjNative *native = (ObjNative *)object;
+        markObject((Obj *)native->name);
+        break;
+    }
+    case OBJ_DATA_TYPE:
+    {
+        // only the name of the embedded class is used
+        markObject((Obj *)((ObjDataType *)object)->classType.name);
+        break;
+    }
     case OBJ_STRING:
         break;
     }
@@ -166,8 +335,17 @@ static void markRoots()
 
     // mark globals
     markTable(&vm.globals);
+    markTable(&vm.globalsTypes);
+    markTable(&vm.nativeVars);
     markObject((Obj *)vm.initString);
 
+    // mark the natives backing the builtin methods
+    markArray(&numberMethods);
+    markArray(&stringMethods);
+    markArray(&arrayMethods);
+    markArray(&stringBuilderMethods);
+    markArray(&mapMethods);
+
     markCompilerRoots();
 }
 
@@ -180,15 +358,230 @@ static void traceReferences()
     }
 }
 
-static void sweep()
+// ------------- parallel marking --------------
+// a big full collection is traced by vm.gcThreads markers. each drains
+// its own gray stack and, while others are out of work, hands a packet
+// of its gray objects to the shared pool, where idle markers take
+// them from. marks are set atomically, so an object is grayed once
+
+// gray objects a marker hands over at a time
+#define GC_PACKET_SIZE 256
+
+typedef struct Packet
+{
+    struct Packet *next;
+    int count;
+    Obj *objects[GC_PACKET_SIZE];
+} Packet;
+
+static struct
+{
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    Packet *packets;  // shared gray objects
+    int threads;      // markers taking part
+    atomic_int idle;  // markers waiting for a packet
+    bool done;        // every marker ran out of work
+} pool = {.lock = PTHREAD_MUTEX_INITIALIZER, .cond = PTHREAD_COND_INITIALIZER};
+
+// moves the top of m's gray stack into the pool
+static void sharePacket(Marker *m)
+{
+    Packet *packet = malloc(sizeof(Packet));
+    if (packet == NULL)
+        exit(1);
+    packet->count = m->count / 2 < GC_PACKET_SIZE ? m->count / 2 : GC_PACKET_SIZE;
+    m->count -= packet->count;
+    memcpy(packet->objects, &m->stack[m->count], sizeof(Obj *) * packet->count);
+
+    pthread_mutex_lock(&pool.lock);
+    packet->next = pool.packets;
+    pool.packets = packet;
+    pthread_cond_signal(&pool.cond);
+    pthread_mutex_unlock(&pool.lock);
+}
+
+// waits for a packet and moves it into m's gray stack. returns false
+// once all markers are idle, as no more work can come up then
+static bool takePacket(Marker *m)
+{
+    pthread_mutex_lock(&pool.lock);
+    pool.idle++;
+    while (pool.packets == NULL && !pool.done)
+    {
+        if (pool.idle == pool.threads)
+        {
+            pool.done = true;
+            pthread_cond_broadcast(&pool.cond);
+        }
+        else
+            pthread_cond_wait(&pool.cond, &pool.lock);
+    }
+
+    Packet *packet = pool.packets;
+    if (packet != NULL)
+    {
+        pool.packets = packet->next;
+        pool.idle--;
+    }
+    pthread_mutex_unlock(&pool.lock);
+
+    if (packet == NULL)
+        return false;
+    for (int i = 0; i < packet->count; i++)
+        pushMarker(m, packet->objects[i]);
+    free(packet);
+    return true;
+}
+
+static void *runMarker(void *arg)
+{
+    Marker *m = arg;
+    marker = m;
+    do
+    {
+        while (m->count > 0)
+        {
+            blackenObject(m->stack[--m->count]);
+            if (m->count > 1 && atomic_load_explicit(&pool.idle, memory_order_relaxed) > 0)
+                sharePacket(m);
+        }
+    } while (takePacket(m));
+    marker = NULL;
+    return NULL;
+}
+
+// traceReferences() on vm.gcThreads threads, for heaps big enough to
+// make up for starting them. busy markers push packets to one shared
+// pool instead of idle markers stealing from per-thread deques, so
+// nothing is taken from a stack its owner is still popping
+static void traceParallel()
+{
+    int threads = vm.gcThreads;
+#ifdef DEBUG_LOG_GC
+    threads = 1; // the log would be interleaved
+#endif
+    if (threads <= 1 || vm.bytesAllocated < GC_PARALLEL_HEAP || vm.grayCount == 0)
+    {
+        traceReferences();
+        return;
+    }
+
+    // this thread goes on with the roots, the others start idle and
+    // get their work from it
+    Marker markers[GC_MAX_THREADS] = {0};
+    markers[0].stack = vm.grayStack;
+    markers[0].count = vm.grayCount;
+    markers[0].capacity = vm.grayCapacity;
+    pool.packets = NULL;
+    pool.threads = 1;
+    pool.idle = 0;
+    pool.done = false;
+
+    for (int i = 1; i < threads; i++)
+    {
+        pthread_mutex_lock(&pool.lock);
+        pool.threads++;
+        pthread_mutex_unlock(&pool.lock);
+        if (pthread_create(&markers[i].thread, NULL, runMarker, &markers[i]) != 0)
+        {
+            pthread_mutex_lock(&pool.lock);
+            pool.threads--;
+            pthread_mutex_unlock(&pool.lock);
+            threads = i;
+            break;
+        }
+    }
+
+    runMarker(&markers[0]);
+
+    for (int i = 1; i < threads; i++)
+    {
+        pthread_join(markers[i].thread, NULL);
+        free(markers[i].stack);
+    }
+    vm.grayStack = markers[0].stack;
+    vm.grayCapacity = markers[0].capacity;
+    vm.grayCount = 0;
+}
+
+// returns the default of vm.gcThreads: one per core, up to
+// GC_MAX_THREADS
+int defaultGcThreads()
+{
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    if (cores < 1)
+        return 1;
+    return cores < GC_MAX_THREADS ? (int)cores : GC_MAX_THREADS;
+}
+
+// like traceReferences() but stops once budget work is done. arrays
+// longer than that are traced over several calls
+static void traceSome(size_t budget)
+{
+    size_t start = work;
+    while (work - start < budget)
+    {
+        if (vm.scanArray != NULL)
+        {
+            ValueArray *array = &vm.scanArray->array;
+            while (vm.scanIndex < array->count && work - start < budget)
+            {
+                markValue(array->values[vm.scanIndex++]);
+                work++;
+            }
+            if (vm.scanIndex >= array->count)
+                vm.scanArray = NULL;
+            continue;
+        }
+
+        if (vm.grayCount == 0)
+            break;
+        Obj *object = vm.grayStack[--vm.grayCount];
+        if (object->type == OBJ_ARRAY && ((ObjArray *)object)->array.count > budget)
+        {
+            vm.scanArray = (ObjArray *)object;
+            vm.scanIndex = 0;
+        }
+        else
+            blackenObject(object);
+    }
+}
+
+// traces the old objects that were written to, as they may be the
+// only ones pointing to some young objects, and marks the young
+// values that were stored into old objects
+static void markRemembered()
+{
+    for (int i = 0; i < vm.rememberedCount; i++)
+        traceObject(vm.remembered[i]);
+}
+
+static void forgetRemembered()
+{
+    for (int i = 0; i < vm.rememberedCount; i++)
+        vm.remembered[i]->isRemembered = false;
+    vm.rememberedCount = 0;
+}
+
+// unmarks every object. young objects are unmarked already and would
+// read as marked after the flip
+static void flipMarks()
+{
+    vm.markBit = !vm.markBit;
+    for (Obj *object = vm.youngObjects; object != NULL; object = object->next)
+        object->mark = !vm.markBit;
+}
+
+// frees the unmarked old objects. the others keep their mark
+static void sweepOld()
 {
     Obj *previous = NULL;
     Obj *object = vm.objects;
     while (object != NULL)
     {
-        if (object->isMarked)
+        if (IS_MARKED(object))
         {
-            object->isMarked = false;
             previous = object;
             object = object->next;
         }
@@ -210,50 +603,674 @@ static void sweep()
     }
 }
 
-// collects and frees all garbage
-void collectGarbage()
+// frees the unmarked young objects and promotes the others. dead
+// strings leave the intern table here, so a minor collection does
+// not have to scan all of it
+static void sweepYoung()
+{
+    Obj *object = vm.youngObjects;
+    while (object != NULL)
+    {
+        Obj *next = object->next;
+        if (IS_MARKED(object))
+        {
+            object->next = vm.objects;
+            vm.objects = object;
+        }
+        else
+        {
+            if (object->type == OBJ_STRING && ((ObjString *)object)->isInterned)
+                tableDelete(&vm.strings, (ObjString *)object);
+            freeObject(object);
+        }
+        object = next;
+    }
+    vm.youngObjects = NULL;
+}
+
+// ------------ incremental collection ------------
+// a full collection of a big heap is split into steps that each do
+// vm.stepWork work, one every GC_STEP_SIZE allocated bytes:
+//  GC_MARK:  the gray stack is traced a slice at a time. the write
+//            barriers record every store into a marked object in
+//            vm.remembered, which each step traces again, so a black
+//            object never keeps a white one alive unnoticed. objects
+//            allocated meanwhile are white, reached through the
+//            roots, which every step marks again
+//  GC_SWEEP: the sweeper thread frees the unmarked objects, steps
+//            only check whether it is done
+// minor collections wait while marking, as young objects are white
+// for both. they go on while sweeping
+
+// frees the unmarked objects of the lists handed over by
+// startSweep() and links the marked ones into sweeper.survivors
+static void *sweepLists(void *unused)
+{
+    (void)unused;
+    onSweeper = true;
+    Obj **link = &sweeper.survivors;
+    for (int i = 0; i < 2; i++)
+    {
+        Obj *object = sweeper.lists[i];
+        while (object != NULL)
+        {
+            Obj *next = object->next;
+            if (object->mark == sweeper.markBit)
+            {
+                *link = object;
+                link = &object->next;
+            }
+            else
+                freeObject(object);
+            object = next;
+        }
+    }
+    *link = NULL;
+    sweeper.tail = link;
+    onSweeper = false;
+    atomic_store(&sweeper.done, true);
+    return NULL;
+}
+
+// hands every non-young object to the sweeper thread. from here on
+// vm.objects only collects what minor collections promote
+static void startSweep()
+{
+    sweeper.lists[0] = vm.youngObjects; // allocated while marking
+    sweeper.lists[1] = vm.objects;
+    sweeper.markBit = vm.markBit;
+    sweeper.survivors = NULL;
+    memset(sweeper.typeBytes, 0, sizeof(sweeper.typeBytes));
+    atomic_store(&sweeper.done, false);
+    vm.objects = NULL;
+    vm.youngObjects = NULL;
+
+    sweeper.running = pthread_create(&sweeper.thread, NULL, sweepLists, NULL) == 0;
+    if (!sweeper.running)
+        sweepLists(NULL);
+}
+
+// where the next full collection starts, from the bytes that
+// survived this one and vm.heapPolicy
+static size_t nextThreshold()
+{
+    HeapPolicy *policy = &vm.heapPolicy;
+    size_t interval = (size_t)(vm.bytesAllocated * (policy->growFactor - 1));
+    if (interval < policy->minInterval)
+        interval = policy->minInterval;
+    if (policy->maxInterval != 0 && interval > policy->maxInterval)
+        interval = policy->maxInterval;
+
+    // leave room below the cap for the collection to run in
+    size_t next = vm.bytesAllocated + interval;
+    if (policy->maxHeap != 0 && next > policy->maxHeap / 4 * 3)
+        next = policy->maxHeap / 4 * 3;
+    return next;
+}
+
+// pauses nest, as a full collection finishes a running cycle first
+static int pauseDepth = 0;
+static struct timespec pauseStart;
+
+static void beginPause()
+{
+    if (pauseDepth++ == 0)
+        clock_gettime(CLOCK_MONOTONIC, &pauseStart);
+}
+
+static void endPause()
+{
+    if (--pauseDepth > 0)
+        return;
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    double pause = (now.tv_sec - pauseStart.tv_sec) +
+                   (now.tv_nsec - pauseStart.tv_nsec) / 1e9;
+    vm.gcStats.pauseTotal += pause;
+    if (pause > vm.gcStats.pauseMax)
+        vm.gcStats.pauseMax = pause;
+}
+
+// starts an incremental full collection
+static void startCycle()
+{
+    beginPause();
+    #ifdef DEBUG_LOG_GC
+        printf("-- gc cycle begin\n");
+    #endif
+
+    vm.collecting = true;
+    flipMarks();
+    forgetRemembered();
+    markRoots();
+    vm.gcPhase = GC_MARK;
+    vm.stepBytes = 0;
+    vm.collecting = false;
+    endPause();
+}
+
+// ends marking in one go. only what changed since the last step is
+// left to trace
+static void finishMark()
+{
+    if (vm.scanArray != NULL)
+    {
+        markArray(&vm.scanArray->array);
+        vm.scanArray = NULL;
+    }
+    markRoots();
+    markRemembered();
+    traceParallel(); // a lot is left when the steps fell behind
+    forgetRemembered();
+    tableRemoveWhite(&vm.strings);
+    tableCompact(&vm.strings);
+
+    startSweep();
+    vm.youngBytes = 0;
+    vm.gcPhase = GC_SWEEP;
+
+    #ifdef DEBUG_LOG_GC
+        printf("-- gc mark end\n");
+    #endif
+}
+
+// subtracts what the sweeper freed so far from vm.bytesAllocated
+static void collectFreedBytes()
+{
+    size_t freed = atomic_exchange(&freedBytes, 0);
+    vm.bytesAllocated -= freed;
+    vm.gcStats.bytesFreed += freed;
+}
+
+// waits for the sweeper and puts the survivors back into the old list
+static void finishSweep()
+{
+    if (sweeper.running)
+    {
+        pthread_join(sweeper.thread, NULL);
+        sweeper.running = false;
+    }
+    *sweeper.tail = vm.objects;
+    vm.objects = sweeper.survivors;
+    collectFreedBytes();
+    slabReclaim();
+    for (int i = 0; i < OBJ_TYPE_COUNT; i++)
+        vm.gcStats.typeBytes[i] -= sweeper.typeBytes[i];
+
+    vm.gcPhase = GC_IDLE;
+    vm.gcStats.fullCollections++;
+    vm.nextGC = nextThreshold();
+    if (vm.heapPolicy.compact && slabFragmented())
+        vm.compactPending = true;
+
+    #ifdef DEBUG_LOG_GC
+        printf("-- gc cycle end, %zu bytes, next at %zu\n",
+               vm.bytesAllocated, vm.nextGC);
+    #endif
+}
+
+// does one slice of the running incremental collection
+static void collectStep()
+{
+    beginPause();
+    vm.collecting = true;
+    vm.stepBytes = 0;
+    vm.gcStats.steps++;
+    if (vm.gcPhase == GC_MARK)
+    {
+        // roots are written to without barriers
+        markRoots();
+        markRemembered();
+        forgetRemembered();
+        traceSome(vm.stepWork);
+        if (vm.grayCount == 0 && vm.scanArray == NULL)
+            finishMark();
+    }
+    else
+    {
+        collectFreedBytes();
+        if (atomic_load(&sweeper.done))
+            finishSweep();
+    }
+    vm.collecting = false;
+    endPause();
+}
+
+// runs the rest of an incremental collection, if there is one
+static void finishCycle()
+{
+    if (vm.gcPhase == GC_IDLE)
+        return;
+
+    beginPause();
+    vm.collecting = true;
+    if (vm.gcPhase == GC_MARK)
+        finishMark();
+    finishSweep();
+    vm.collecting = false;
+    endPause();
+}
+
+// ------------------------------------------------
+
+// a minor collection only traces young objects: everything old is
+// still marked from before and counts as alive. afterwards all
+// survivors are old. a full collection unmarks everything first, and
+// is done in one go
+static void collect(bool full)
 {
     #ifdef DEBUG_LOG_GC
-        printf("-- gc begin\n");
+        printf("-- gc begin (%s)\n", full ? "full" : "minor");
         size_t before = vm.bytesAllocated;
+        int stringsBefore = vm.strings.capacity;
     #endif
 
+    beginPause();
+    if (full)
+        finishCycle();
+
+    vm.collecting = true;
+    size_t allocated = vm.bytesAllocated;
+
+    if (full)
+        flipMarks();
+
     markRoots();
-    traceReferences();
-    tableRemoveWhite(&vm.strings); // clear unused strings first
-                                   // bc they are referenced by
-                                   // the objects sweep() clears
-    sweep();
+    if (full)
+        traceParallel();
+    else
+    {
+        markRemembered();
+        traceReferences();
+    }
+    forgetRemembered(); // before the sweeps free some of them
+    if (full)
+    {
+        tableRemoveWhite(&vm.strings); // clear unused strings first
+                                       // bc they are referenced by
+                                       // the objects the sweeps clear
+        sweepOld();
+    }
+    sweepYoung();
+
+    // give the intern table back what the dead strings took
+    tableCompact(&vm.strings);
 
-    vm.nextGC = vm.bytesAllocated * GC_HEAP_GROW_FACTOR;
+    vm.collecting = false;
+    vm.youngBytes = 0;
+    if (full)
+        vm.nextGC = nextThreshold();
+
+    if (vm.bytesAllocated < allocated)
+        vm.gcStats.bytesFreed += allocated - vm.bytesAllocated;
+    if (full)
+        vm.gcStats.fullCollections++;
+    else
+        vm.gcStats.minorCollections++;
+    if (full && vm.heapPolicy.compact && slabFragmented())
+        vm.compactPending = true;
+    endPause();
 
     #ifdef DEBUG_LOG_GC
         printf("-- gc end\n");
         printf("   collected %zu bytes (from %zu to %zu) next at %zu\n",
                before - vm.bytesAllocated, before, vm.bytesAllocated,
                vm.nextGC);
+        printf("   strings: %d live, %d slots (from %d)\n",
+               vm.strings.count, vm.strings.capacity, stringsBefore);
     #endif
 }
 
+// collects and frees all garbage
+void collectGarbage()
+{
+    collect(true);
+}
+
+// ------------------ compaction ------------------
+// in a long running program the slab pages end up sparsely used once
+// most of what it allocated at some point is gone. compaction moves
+// the live objects of the emptiest pages into the gaps of the fullest
+// ones and gives the emptied pages back to the OS. objects move, so it
+// may only run while no C code holds object pointers: between
+// instructions (see OP_JUMP_BACK) or in a native that returns right
+// after. objects too big for a slab stay where they are
+
+// bytes of an object as allocated by allocateObjectMemory()
+static size_t objectSize(Obj *object)
+{
+    switch (object->type)
+    {
+    case OBJ_BOUND_METHOD: return sizeof(ObjBoundMethod);
+    case OBJ_CLASS: return sizeof(ObjClass);
+    case OBJ_CLOSURE: return sizeof(ObjClosure);
+    case OBJ_STRING: return sizeof(ObjString) + ((ObjString *)object)->length + 1;
+    case OBJ_FUNCTION: return sizeof(ObjFunction);
+    case OBJ_INSTANCE: return sizeof(ObjInstance);
+    case OBJ_NATIVE: return sizeof(ObjNative);
+    case OBJ_BOUND_N_M: return sizeof(ObjBoundNativeMethod);
+    case OBJ_UPVALUE: return sizeof(ObjUpvalue);
+    case OBJ_ARRAY: return sizeof(ObjArray);
+    case OBJ_STRING_BUILDER: return sizeof(ObjStringBuilder);
+    case OBJ_MAP: return sizeof(ObjMap);
+    case OBJ_MEMO: return sizeof(ObjMemo);
+    case OBJ_DATA_TYPE: return sizeof(ObjDataType);
+    case OBJ_MODULE: return sizeof(ObjModule);
+    }
+    return 0;
+}
+
+// where object is now. compaction runs right after a full collection,
+// so everything reachable is marked. a moved object leaves an unmarked
+// copy behind, with the new address in next
+Obj *forwardObject(Obj *object)
+{
+    if (object == NULL || object->mark == vm.markBit)
+        return object;
+    return object->next;
+}
+
+void forwardValue(Value *value)
+{
+    if (IS_OBJ(*value))
+        value->as.obj = forwardObject(AS_OBJ(*value));
+}
+
+static void forwardArray(ValueArray *array)
+{
+    for (int i = 0; i < array->count; i++)
+        forwardValue(&array->values[i]);
+}
+
+#define FORWARD(pointer) ((pointer) = (void *)forwardObject((Obj *)(pointer)))
+
+// moves the objects on evacuated pages, relinking the old list as it
+// goes
+static void evacuate()
+{
+    Obj **link = &vm.objects;
+    while (*link != NULL)
+    {
+        Obj *object = *link;
+        size_t size = objectSize(object);
+        if (size <= SLAB_MAX_SIZE && slabEvacuating(object))
+        {
+            Obj *moved = slabAllocate(size);
+            memcpy(moved, object, size);
+            object->mark = !vm.markBit;
+            object->next = moved;
+            *link = moved;
+            object = moved;
+        }
+        link = &object->next;
+    }
+}
+
+// points the references in object at the moved objects
+static void forwardFields(Obj *object)
+{
+    switch (object->type)
+    {
+    case OBJ_BOUND_METHOD:
+    {
+        ObjBoundMethod *bound = (ObjBoundMethod *)object;
+        forwardValue(&bound->receiver);
+        FORWARD(bound->method);
+        break;
+    }
+    case OBJ_CLASS:
+    {
+        ObjClass *klass = (ObjClass *)object;
+        forwardTable(&klass->methods);
+        forwardTable(&klass->fields);
+        forwardTable(&klass->fieldsTypes);
+        FORWARD(klass->name);
+        break;
+    }
+    case OBJ_CLOSURE:
+    {
+        ObjClosure *closure = (ObjClosure *)object;
+        FORWARD(closure->function);
+        for (int i = 0; i < closure->upvalueCount; i++)
+            FORWARD(closure->upvalues[i]);
+        break;
+    }
+    case OBJ_UPVALUE:
+    {
+        ObjUpvalue *upvalue = (ObjUpvalue *)object;
+        forwardValue(&upvalue->closed);
+        FORWARD(upvalue->next);
+        // a closed upvalue points at its own closed field
+        if (upvalue->location < vm.stack || upvalue->location >= vm.stack + STACK_MAX)
+            upvalue->location = &upvalue->closed;
+        break;
+    }
+    case OBJ_FUNCTION:
+    {
+        ObjFunction *function = (ObjFunction *)object;
+        FORWARD(function->name);
+        forwardArray(&function->chunk.constants);
+        forwardArray(&function->argTypes);
+        FORWARD(function->returnType.classType.name);
+        break;
+    }
+    case OBJ_INSTANCE:
+    {
+        ObjInstance *instance = (ObjInstance *)object;
+        FORWARD(instance->klass);
+        forwardTable(&instance->fields);
+        forwardTable(&instance->fieldsTypes);
+        break;
+    }
+    case OBJ_ARRAY:
+        forwardArray(&((ObjArray *)object)->array);
+        break;
+    case OBJ_BOUND_N_M:
+    {
+        ObjBoundNativeMethod *method = (ObjBoundNativeMethod *)object;
+        forwardValue(&method->receiver);
+        FORWARD(method->native);
+        break;
+    }
+    case OBJ_MODULE:
+    {
+        ObjModule *module = (ObjModule *)object;
+        forwardTable(&module->fields);
+        forwardTable(&module->fieldsTypes);
+        FORWARD(module->name);
+        FORWARD(module->path);
+        break;
+    }
+    case OBJ_STRING_BUILDER:
+        FORWARD(((ObjStringBuilder *)object)->string);
+        break;
+    case OBJ_MAP:
+        forwardValueTable(&((ObjMap *)object)->table);
+        break;
+    case OBJ_MEMO:
+        forwardMemo((ObjMemo *)object);
+        break;
+    case OBJ_NATIVE:
+        FORWARD(((ObjNative *)object)->name);
+        break;
+    case OBJ_DATA_TYPE:
+        FORWARD(((ObjDataType *)object)->classType.name);
+        break;
+    case OBJ_STRING:
+        break;
+    }
+}
+
+// the same roots markRoots() starts from, and the intern table
+static void forwardRoots()
+{
+    for (Value *slot = vm.stack; slot < vm.stackTop; slot++)
+        forwardValue(slot);
+    for (int i = 0; i < vm.frameCount; i++)
+        FORWARD(vm.frames[i].closure);
+    FORWARD(vm.openUpvalues);
+
+    forwardTable(&vm.globals);
+    forwardTable(&vm.globalsTypes);
+    forwardTable(&vm.nativeVars);
+    forwardTable(&vm.strings);
+    FORWARD(vm.initString);
+
+    forwardArray(&numberMethods);
+    forwardArray(&stringMethods);
+    forwardArray(&arrayMethods);
+    forwardArray(&stringBuilderMethods);
+    forwardArray(&mapMethods);
+}
+
+// compacts the slab pages after a full collection and returns the
+// bytes given back to the OS
+size_t compactHeap()
+{
+    collect(true);
+    vm.compactPending = false;
+
+    beginPause();
+    vm.collecting = true;
+    slabBeginCompaction();
+    for (Obj *object = vm.objects; object != NULL; object = object->next)
+    {
+        if (objectSize(object) <= SLAB_MAX_SIZE)
+            slabMarkLive(object);
+    }
+
+    size_t released = 0;
+    if (slabPlanCompaction())
+    {
+        evacuate();
+        forwardRoots();
+        for (Obj *object = vm.objects; object != NULL; object = object->next)
+            forwardFields(object);
+        released = slabEndCompaction();
+    }
+#ifdef __GLIBC__
+    // what freed objects and buffers left in the malloc heap
+    malloc_trim(0);
+#endif
+    vm.collecting = false;
+    endPause();
+
+    #ifdef DEBUG_LOG_GC
+        printf("-- gc compact, %zu bytes released\n", released);
+    #endif
+    return released;
+}
+
 // ----------------------------------------------
 
-// reallocates memory of size newSize for pointer
-// if newSize is 0, pointer is freed
-void *reallocate(void *pointer, size_t oldSize, size_t newSize)
+// reports running out of memory as a runtime error of the running
+// script. outside of one, or while collecting, there is nothing to
+// unwind to and the process exits
+static void outOfMemory(const char *message)
+{
+    if (vm.heapJump == NULL || vm.collecting)
+    {
+        fprintf(stderr, "%s\n", message);
+        exit(1);
+    }
+    runtimeError("%s", message);
+    longjmp(*vm.heapJump, 1);
+}
+
+// empties every Memoize() cache, returns whether any held something
+static bool dropMemoCaches()
+{
+    bool dropped = false;
+    Obj *lists[] = {vm.objects, vm.youngObjects};
+    for (int i = 0; i < 2; i++)
+    {
+        for (Obj *object = lists[i]; object != NULL; object = object->next)
+        {
+            if (object->type == OBJ_MEMO && ((ObjMemo *)object)->count != 0)
+            {
+                freeMemo((ObjMemo *)object);
+                dropped = true;
+            }
+        }
+    }
+    return dropped;
+}
+
+// called before growing past vm.heapPolicy.maxHeap. a full collection
+// may make room, then one without cached results, else the script
+// fails. compiling goes on regardless, as the compiler cannot be
+// unwound
+static void heapCapReached(size_t size)
 {
+    collect(true);
+    if (vm.bytesAllocated + size > vm.heapPolicy.maxHeap && dropMemoCaches())
+        collect(true);
+    if (vm.bytesAllocated + size > vm.heapPolicy.maxHeap && vm.heapJump != NULL)
+        outOfMemory("Out of memory: the heap limit was reached.");
+}
+
+// updates the byte counts for an allocation going from oldSize to
+// newSize and runs whatever collection work is due
+static void countBytes(size_t oldSize, size_t newSize)
+{
+    if (newSize > oldSize && vm.heapPolicy.maxHeap != 0 && !vm.collecting &&
+        vm.bytesAllocated + (newSize - oldSize) > vm.heapPolicy.maxHeap)
+        heapCapReached(newSize - oldSize);
+
     vm.bytesAllocated += newSize - oldSize;
-    if (newSize > oldSize)
+
+    // only collect when growing, and never from within a collection
+    // (sweeping frees, tableCompact() may allocate)
+    if (newSize > oldSize && !vm.collecting)
     {
+        vm.youngBytes += newSize - oldSize;
+
+        vm.stepBytes += newSize - oldSize;
+
     #ifdef DEBUG_STRESS_GC
-        collectGarbage();
+        // some collection work on every allocation, to catch missing
+        // roots and write barriers
+        static int stress = 0;
+        stress++;
+        if (vm.gcPhase != GC_IDLE)
+            collectStep();
+        if (stress % 1024 == 0)
+            vm.compactPending = true; // moves objects at the next loop
+        if (stress % 64 == 0)
+            collect(true);
+        else if (vm.gcPhase == GC_IDLE && stress % 8 == 0)
+            startCycle();
+        else if (vm.gcPhase != GC_MARK)
+            collect(false);
+    #else
+        if (vm.gcPhase != GC_IDLE && vm.stepBytes > GC_STEP_SIZE)
+            collectStep();
+        // the steps fall behind the program, finish in one go
+        if (vm.gcPhase != GC_IDLE &&
+            vm.bytesAllocated > vm.nextGC * GC_BACKSTOP_FACTOR)
+            finishCycle();
+        if (vm.gcPhase == GC_IDLE && vm.bytesAllocated > vm.nextGC)
+            startCycle();
+        else if (vm.gcPhase != GC_MARK && vm.youngBytes > GC_NURSERY_SIZE)
+            collect(false);
     #endif
     }
+}
 
-    if (vm.bytesAllocated > vm.nextGC)
+// reallocates memory of size newSize for pointer
+// if newSize is 0, pointer is freed
+void *reallocate(void *pointer, size_t oldSize, size_t newSize)
+{
+    // the sweeper thread only frees, and leaves vm alone
+    if (onSweeper)
     {
-        collectGarbage();
+        atomic_fetch_add(&freedBytes, oldSize);
+        free(pointer);
+        return NULL;
     }
 
+    countBytes(oldSize, newSize);
+
     if (newSize == 0)
     {
         free(pointer);
@@ -261,15 +1278,54 @@ void *reallocate(void *pointer, size_t oldSize, size_t newSize)
     }
 
     void *result = realloc(pointer, newSize);
+    if (result == NULL && !vm.collecting)
+    {
+        // free what can be freed and try again
+        collect(true);
+        result = realloc(pointer, newSize);
+    }
     if (result == NULL)
     {
-        // exit if we have no more memory available
-        printf("REALLOCATION FAILED\n");
-        exit(1);
+        vm.bytesAllocated -= newSize - oldSize;
+        outOfMemory("REALLOCATION FAILED");
     }
     return result;
 }
 
+// allocates the memory of an object. small ones come from slabs
+void *allocateObjectMemory(size_t size)
+{
+    if (size > SLAB_MAX_SIZE)
+        return reallocate(NULL, 0, size);
+    countBytes(0, size);
+    return slabAllocate(size);
+}
+
+// frees memory from allocateObjectMemory(size)
+void freeObjectMemory(void *pointer, size_t size)
+{
+    ObjType type = ((Obj *)pointer)->type;
+    if (onSweeper)
+        sweeper.typeBytes[type] += size;
+    else
+        vm.gcStats.typeBytes[type] -= size;
+
+    if (size > SLAB_MAX_SIZE)
+        reallocate(pointer, size, 0);
+    else if (onSweeper)
+    {
+        // the free lists are the program's, they get these blocks
+        // once the sweeper is done
+        atomic_fetch_add(&freedBytes, size);
+        slabDefer(pointer, size);
+    }
+    else
+    {
+        countBytes(size, 0);
+        slabFree(pointer, size);
+    }
+}
+
 // frees a single object
 static void freeObject(Obj *object)
 {
@@ -281,69 +1337,93 @@ static void freeObject(Obj *object)
     {
     case OBJ_BOUND_METHOD:
     {
-        FREE(ObjBoundMethod, object);
+        FREE_OBJ(ObjBoundMethod, object);
         break;
     }
     case OBJ_CLASS:
     {
         ObjClass *klass = (ObjClass *)object;
         freeTable(&klass->methods);
-        FREE(ObjClass, object);
+        freeTable(&klass->fields);
+        freeTable(&klass->fieldsTypes);
+        FREE_OBJ(ObjClass, object);
         break;
     }
     case OBJ_CLOSURE:
     {
         ObjClosure *closure = (ObjClosure *)object;
         FREE_ARRAY(ObjUpvalue *, closure->upvalues, closure->upvalueCount);
-        FREE(ObjClosure, object);
+        FREE_OBJ(ObjClosure, object);
         break;
     }
     case OBJ_STRING:
     {
         ObjString *string = (ObjString *)object;
-        FREE_ARRAY(char, string->chars, string->length + 1);
-        FREE(ObjString, object);
+        freeObjectMemory(object, sizeof(ObjString) + string->length + 1);
         break;
     }
     case OBJ_FUNCTION:
     {
         ObjFunction *function = (ObjFunction *)object;
         freeChunk(&function->chunk);
-        FREE(ObjFunction, object);
+        freeValueArray(&function->argTypes);
+        FREE_OBJ(ObjFunction, object);
         break;
     }
     case OBJ_INSTANCE:
     {
         ObjInstance *instance = (ObjInstance *)object;
         freeTable(&instance->fields);
-        FREE(ObjInstance, object);
+        freeTable(&instance->fieldsTypes);
+        FREE_OBJ(ObjInstance, object);
         break;
     }
     case OBJ_NATIVE:
     {
-        FREE(ObjNative, object);
+        FREE_OBJ(ObjNative, object);
         break;
     }
     case OBJ_BOUND_N_M:
     {
-        FREE(ObjBoundNativeMethod, object);
+        FREE_OBJ(ObjBoundNativeMethod, object);
         break;
     }
     case OBJ_UPVALUE:
     {
-        FREE(ObjUpvalue, object);
+        FREE_OBJ(ObjUpvalue, object);
         break;
     }
     case OBJ_ARRAY:
     {
         ObjArray *array = (ObjArray *)object;
         freeValueArray(&array->array);
-        FREE(ObjArray, object);
+        FREE_OBJ(ObjArray, object);
+        break;
+    }
+    case OBJ_STRING_BUILDER:
+    {
+        ObjStringBuilder *builder = (ObjStringBuilder *)object;
+        if (builder->buffer != NULL)
+            reallocate(builder->buffer, sizeof(ObjString) + builder->capacity + 1, 0);
+        FREE_OBJ(ObjStringBuilder, object);
+        break;
+    }
+    case OBJ_MAP:
+    {
+        ObjMap *map = (ObjMap *)object;
+        freeValueTable(&map->table);
+        FREE_OBJ(ObjMap, object);
+        break;
+    }
+    case OBJ_MEMO:
+    {
+        freeMemo((ObjMemo *)object);
+        FREE_OBJ(ObjMemo, object);
         break;
     }
     case OBJ_DATA_TYPE:
     {
-        FREE(ObjDataType, object);
+        FREE_OBJ(ObjDataType, object);
         break;
     }
     case OBJ_MODULE:
@@ -351,46 +1431,161 @@ static void freeObject(Obj *object)
         ObjModule *module = (ObjModule *)object;
         freeTable(&module->fields);
         freeTable(&module->fieldsTypes);
-        FREE(ObjModule, object);
+        FREE_OBJ(ObjModule, object);
         break;
     }
     }
 }
 
+// prints the summary of --gc-stats
+void printGcStats(FILE *file)
+{
+    GcStats *stats = &vm.gcStats;
+    fprintf(file, "-- gc stats\n");
+    fprintf(file, "   collections: %d minor, %d full (%d steps)\n",
+            stats->minorCollections, stats->fullCollections, stats->steps);
+    fprintf(file, "   pauses: %.3f ms total, %.3f ms max\n",
+            stats->pauseTotal * 1e3, stats->pauseMax * 1e3);
+    fprintf(file, "   freed: %zu bytes\n", stats->bytesFreed);
+    fprintf(file, "   heap: %zu bytes, next full collection at %zu\n",
+            vm.bytesAllocated, vm.nextGC);
+    fprintf(file, "   strings: %d interned, %d slots\n",
+            vm.strings.count, vm.strings.capacity);
+    fprintf(file, "   live object bytes:\n");
+    for (int i = 0; i < OBJ_TYPE_COUNT; i++)
+    {
+        if (stats->typeBytes[i] != 0)
+            fprintf(file, "     %-14s %zu\n", objTypeName(i), stats->typeBytes[i]);
+    }
+}
+
 // frees the VM's objects from memory
 void freeObjects()
 {
-    Obj *object = vm.objects;
-    while (object != NULL)
+    if (vm.gcPhase == GC_SWEEP)
+        finishSweep();
+
+    Obj *lists[] = {vm.objects, vm.youngObjects};
+    for (int i = 0; i < 2; i++)
     {
-        Obj *next = object->next;
-        freeObject(object);
-        object = next;
+        Obj *object = lists[i];
+        while (object != NULL)
+        {
+            Obj *next = object->next;
+            freeObject(object);
+            object = next;
+        }
     }
+    freeSlabs();
     free(vm.grayStack);
+    free(vm.remembered);
 }
 
+// ------------------- scratch --------------------
+// short lived text lives in chunks that are bump allocated and dropped
+// all at once. a chunk of the default size is kept when emptied, so
+// printing in a loop does not go back to malloc() every time
+
+#define SCRATCH_CHUNK_SIZE (16 * 1024)
+
+typedef struct ScratchChunk
+{
+    struct ScratchChunk *previous;
+    size_t capacity;
+    size_t used;
+    char data[];
+} ScratchChunk;
+
+// room for size more bytes, in a new chunk if the current one is full
+static ScratchChunk *scratchRoom(size_t size)
+{
+    ScratchChunk *chunk = vm.scratch;
+    if (chunk != NULL && chunk->capacity - chunk->used >= size)
+        return chunk;
+
+    if (size <= SCRATCH_CHUNK_SIZE && vm.scratchSpare != NULL)
+    {
+        chunk = vm.scratchSpare;
+        vm.scratchSpare = NULL;
+    }
+    else
+    {
+        size_t capacity = size > SCRATCH_CHUNK_SIZE ? size : SCRATCH_CHUNK_SIZE;
+        chunk = malloc(sizeof(ScratchChunk) + capacity);
+        if (chunk == NULL)
+            outOfMemory("REALLOCATION FAILED");
+        chunk->capacity = capacity;
+    }
+    chunk->previous = vm.scratch;
+    chunk->used = 0;
+    vm.scratch = chunk;
+    return chunk;
+}
+
+void *scratchAllocate(size_t size)
+{
+    // keep everything 8-byte aligned
+    size = (size + 7) & ~(size_t)7;
+    ScratchChunk *chunk = scratchRoom(size);
+    void *memory = chunk->data + chunk->used;
+    chunk->used += size;
+    return memory;
+}
+
+ScratchMark scratchMark()
+{
+    return (ScratchMark){vm.scratch, vm.scratch != NULL ? vm.scratch->used : 0};
+}
+
+// frees everything allocated since mark was taken
+void scratchReset(ScratchMark mark)
+{
+    while (vm.scratch != mark.chunk)
+    {
+        ScratchChunk *chunk = vm.scratch;
+        vm.scratch = chunk->previous;
+        if (vm.scratchSpare == NULL && chunk->capacity == SCRATCH_CHUNK_SIZE)
+            vm.scratchSpare = chunk;
+        else
+            free(chunk);
+    }
+    if (vm.scratch != NULL)
+        vm.scratch->used = mark.used;
+}
+
+// frees the scratch memory for good
+void freeScratch()
+{
+    scratchReset((ScratchMark){NULL, 0});
+    free(vm.scratchSpare);
+    vm.scratchSpare = NULL;
+}
+
+// printf() into scratch memory. the result is gone at the next reset,
+// use it or copy it before
 char *formatString(const char *format, ...)
 {
     va_list args;
-    va_start(args, format);
 
-    int smallSize = sizeof(char) * 1024;
-    char *smallBuffer = malloc(smallSize);
-    
-    int size = vsnprintf(smallBuffer, smallSize, format, args);
+    // most results fit into what is left of the current chunk
+    ScratchChunk *chunk = vm.scratch;
+    if (chunk != NULL)
+    {
+        size_t room = chunk->capacity - chunk->used;
+        va_start(args, format);
+        int size = vsnprintf(chunk->data + chunk->used, room, format, args);
+        va_end(args);
+        if ((size_t)size < room)
+            return scratchAllocate(size + 1);
+    }
 
+    va_start(args, format);
+    int size = vsnprintf(NULL, 0, format, args);
     va_end(args);
-    
-    if (size < sizeof smallBuffer)
-        return smallBuffer;
-
-    int bigSize = sizeof(char) * (size + 1);
-    char *buffer = malloc(bigSize);
 
+    char *buffer = scratchAllocate(size + 1);
     va_start(args, format);
-    vsnprintf(buffer, bigSize, format, args);
+    vsnprintf(buffer, size + 1, format, args);
     va_end(args);
-    
     return buffer;
-}
\ No newline at end of file
+}
@@ -0,0 +1,262 @@
+#include <string.h>
+
+#include "memo.h"
+#include "hash.h"
+#include "mem.h"
+#include "table.h"
+#include "value.h"
+
+// entries, their keys and the slots share one allocation, so a cache
+// is never left half grown
+static size_t blockSize(int arity, int capacity, int slotCapacity)
+{
+    return capacity * sizeof(MemoEntry) + (size_t)capacity * arity * sizeof(Value) +
+           slotCapacity * sizeof(int);
+}
+
+static uint32_t hashArgs(Value *args, int arity)
+{
+    uint64_t hash = hashSecret[2];
+    for (int i = 0; i < arity; i++)
+        hash = hashMix(hash ^ hashValue(args[i]), hashSecret[3]);
+    return (uint32_t)hash;
+}
+
+static bool argsEqual(Value *a, Value *b, int arity)
+{
+    for (int i = 0; i < arity; i++)
+    {
+        if (!valuesEqual(a[i], b[i]))
+            return false;
+    }
+    return true;
+}
+
+// the slot holding the entry for args, or the empty one it would go to
+static int findSlot(ObjMemo *memo, Value *args, uint32_t hash)
+{
+    int mask = memo->slotCapacity - 1;
+    for (int slot = hash & mask;; slot = (slot + 1) & mask)
+    {
+        int entry = memo->slots[slot];
+        if (entry == -1)
+            return slot;
+        if (memo->entries[entry].hash == hash &&
+            argsEqual(&memo->keys[entry * memo->arity], args, memo->arity))
+            return slot;
+    }
+}
+
+static void insertSlot(ObjMemo *memo, int entry)
+{
+    int mask = memo->slotCapacity - 1;
+    int slot = memo->entries[entry].hash & mask;
+    while (memo->slots[slot] != -1)
+        slot = (slot + 1) & mask;
+    memo->slots[slot] = entry;
+}
+
+// takes entry out of the index, shifting back the entries after it
+// that would not be found otherwise
+static void removeSlot(ObjMemo *memo, int entry)
+{
+    int mask = memo->slotCapacity - 1;
+    int slot = memo->entries[entry].hash & mask;
+    while (memo->slots[slot] != entry)
+        slot = (slot + 1) & mask;
+
+    for (int next = (slot + 1) & mask; memo->slots[next] != -1; next = (next + 1) & mask)
+    {
+        int home = memo->entries[memo->slots[next]].hash & mask;
+        // stays if its home lies in (slot, next]
+        if (slot <= next ? (slot < home && home <= next) : (slot < home || home <= next))
+            continue;
+        memo->slots[slot] = memo->slots[next];
+        slot = next;
+    }
+    memo->slots[slot] = -1;
+}
+
+static void rebuildSlots(ObjMemo *memo)
+{
+    memset(memo->slots, -1, memo->slotCapacity * sizeof(int));
+    for (int i = 0; i < memo->count; i++)
+        insertSlot(memo, i);
+}
+
+static void unlinkEntry(ObjMemo *memo, int entry)
+{
+    MemoEntry *e = &memo->entries[entry];
+    if (e->newer != -1)
+        memo->entries[e->newer].older = e->older;
+    else
+        memo->newest = e->older;
+    if (e->older != -1)
+        memo->entries[e->older].newer = e->newer;
+    else
+        memo->oldest = e->newer;
+}
+
+static void linkNewest(ObjMemo *memo, int entry)
+{
+    MemoEntry *e = &memo->entries[entry];
+    e->newer = -1;
+    e->older = memo->newest;
+    if (memo->newest != -1)
+        memo->entries[memo->newest].newer = entry;
+    else
+        memo->oldest = entry;
+    memo->newest = entry;
+}
+
+static void grow(ObjMemo *memo)
+{
+    int capacity = GROW_CAPACITY(memo->capacity);
+    if (memo->maxEntries != 0 && capacity > memo->maxEntries)
+        capacity = memo->maxEntries;
+    int slotCapacity = 16;
+    while (slotCapacity < capacity * 2)
+        slotCapacity *= 2;
+
+    char *block = ALLOCATE(char, blockSize(memo->arity, capacity, slotCapacity));
+    // read only now: the allocation may have dropped the cache
+    int count = memo->count, newest = memo->newest, oldest = memo->oldest;
+    MemoEntry *entries = (MemoEntry *)block;
+    Value *keys = (Value *)(entries + capacity);
+    if (count != 0)
+    {
+        memcpy(entries, memo->entries, count * sizeof(MemoEntry));
+        memcpy(keys, memo->keys, (size_t)count * memo->arity * sizeof(Value));
+    }
+    freeMemo(memo);
+
+    memo->count = count;
+    memo->newest = newest;
+    memo->oldest = oldest;
+    memo->entries = entries;
+    memo->keys = keys;
+    memo->slots = (int *)(keys + (size_t)capacity * memo->arity);
+    memo->capacity = capacity;
+    memo->slotCapacity = slotCapacity;
+    rebuildSlots(memo);
+}
+
+// the least recently used entry that is not pending, taken out of the
+// index and the list. -1 if every entry is pending
+static int evict(ObjMemo *memo)
+{
+    for (int entry = memo->oldest; entry != -1; entry = memo->entries[entry].newer)
+    {
+        if (memo->entries[entry].pending)
+            continue;
+        removeSlot(memo, entry);
+        unlinkEntry(memo, entry);
+        return entry;
+    }
+    return -1;
+}
+
+// looks up the arguments of a call, arity values at args. on a hit the
+// result is stored in result. otherwise entry is set to the pending
+// entry that memoStore() fills in, or to -1 if there is no room
+bool memoLookup(ObjMemo *memo, Value *args, Value *result, int *entry)
+{
+    uint32_t hash = hashArgs(args, memo->arity);
+    if (memo->count != 0)
+    {
+        int found = memo->slots[findSlot(memo, args, hash)];
+        if (found != -1)
+        {
+            MemoEntry *e = &memo->entries[found];
+            // the same call is running already, this one takes over
+            if (e->pending)
+            {
+                e->stamp = ++memo->stamp;
+                *entry = found;
+                return false;
+            }
+            *result = e->result;
+            unlinkEntry(memo, found);
+            linkNewest(memo, found);
+            return true;
+        }
+    }
+
+    if (memo->maxEntries != 0 && memo->count == memo->maxEntries)
+        *entry = evict(memo);
+    else
+    {
+        if (memo->count == memo->capacity)
+            grow(memo);
+        *entry = memo->count++;
+    }
+    if (*entry == -1)
+        return false;
+
+    MemoEntry *e = &memo->entries[*entry];
+    e->hash = hash;
+    e->stamp = ++memo->stamp;
+    e->pending = true;
+    e->result = NULL_VAL;
+    memcpy(&memo->keys[*entry * memo->arity], args, memo->arity * sizeof(Value));
+    linkNewest(memo, *entry);
+    insertSlot(memo, *entry);
+    writeBarrier((Obj *)memo);
+    return false;
+}
+
+// fills in the entry memoLookup() handed out, unless it was dropped or
+// taken over since
+void memoStore(ObjMemo *memo, int entry, uint32_t stamp, Value result)
+{
+    if (entry >= memo->count || memo->entries[entry].stamp != stamp ||
+        !memo->entries[entry].pending)
+        return;
+    memo->entries[entry].pending = false;
+    memo->entries[entry].result = result;
+    writeValueBarrier((Obj *)memo, result);
+}
+
+void markMemo(ObjMemo *memo)
+{
+    markObject((Obj *)memo->closure);
+    for (int i = 0; i < memo->count; i++)
+    {
+        for (int j = 0; j < memo->arity; j++)
+            markValue(memo->keys[i * memo->arity + j]);
+        markValue(memo->entries[i].result);
+    }
+}
+
+// objects hash by address, so moved keys need a rehash
+void forwardMemo(ObjMemo *memo)
+{
+    memo->closure = (ObjClosure *)forwardObject((Obj *)memo->closure);
+    if (memo->count == 0)
+        return;
+    for (int i = 0; i < memo->count; i++)
+    {
+        Value *args = &memo->keys[i * memo->arity];
+        for (int j = 0; j < memo->arity; j++)
+            forwardValue(&args[j]);
+        forwardValue(&memo->entries[i].result);
+        memo->entries[i].hash = hashArgs(args, memo->arity);
+    }
+    rebuildSlots(memo);
+}
+
+// empties the cache and frees its memory. running calls find their
+// entries gone and leave the cache alone
+void freeMemo(ObjMemo *memo)
+{
+    if (memo->entries != NULL)
+        FREE_ARRAY(char, memo->entries,
+                   blockSize(memo->arity, memo->capacity, memo->slotCapacity));
+    memo->entries = NULL;
+    memo->keys = NULL;
+    memo->slots = NULL;
+    memo->count = 0;
+    memo->capacity = 0;
+    memo->slotCapacity = 0;
+    memo->newest = memo->oldest = -1;
+}
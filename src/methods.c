@@ -1,16 +1,29 @@
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
+#include <ctype.h>
+#include <limits.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 #include "methods.h"
 #include "value.h"
 #include "common.h"
 #include "object.h"
 #include "mem.h"
+#include "number.h"
 #include "vm.h"
 
 #define self (args[-1])
 
+ValueArray numberMethods;
+ValueArray stringMethods;
+ValueArray arrayMethods;
+ValueArray stringBuilderMethods;
+ValueArray mapMethods;
+
 // HELPER FUNCTIONS
 
 static bool checkArg(Value arg, int valueType, int objType)
@@ -28,6 +41,74 @@ static Value methodRuntimeError(char *msg)
     return (Value){-1};
 }
 
+// compares everything but the first and last byte. short needles are
+// compared inline, since a memcmp call costs more than the compare
+static inline bool matchesInner(const char *p, const char *needle, int needleLength)
+{
+    if (needleLength > 16)
+        return memcmp(p + 1, needle + 1, needleLength - 2) == 0;
+    for (int i = 1; i < needleLength - 1; i++)
+        if (p[i] != needle[i])
+            return false;
+    return true;
+}
+
+// returns the index of the first occurrence of needle in haystack at or
+// after start, or -1. With SSE2, 16 candidate positions are filtered at
+// once by comparing the first and last byte of the needle, and only the
+// survivors are checked with memcmp. SSE2 rather than AVX2, as the
+// default build targets baseline x86-64.
+static int findSubstring(const char *haystack, int length,
+                         const char *needle, int needleLength, int start)
+{
+    if (needleLength == 0)
+        return start <= length ? start : -1;
+
+    // one past the last position the needle can start at
+    const char *end = haystack + length - needleLength + 1;
+    const char *p = haystack + start;
+    if (p >= end)
+        return -1;
+
+    if (needleLength == 1)
+    {
+        const char *hit = memchr(p, needle[0], end - p);
+        return hit ? hit - haystack : -1;
+    }
+
+    char first = needle[0];
+    char last = needle[needleLength - 1];
+
+#ifdef __SSE2__
+    __m128i firstBytes = _mm_set1_epi8(first);
+    __m128i lastBytes = _mm_set1_epi8(last);
+
+    while (end - p >= 16)
+    {
+        __m128i blockFirst = _mm_loadu_si128((const __m128i *)p);
+        __m128i blockLast = _mm_loadu_si128((const __m128i *)(p + needleLength - 1));
+        unsigned mask = _mm_movemask_epi8(_mm_and_si128(
+            _mm_cmpeq_epi8(blockFirst, firstBytes),
+            _mm_cmpeq_epi8(blockLast, lastBytes)));
+
+        while (mask)
+        {
+            int bit = __builtin_ctz(mask);
+            if (matchesInner(p + bit, needle, needleLength))
+                return p + bit - haystack;
+            mask &= mask - 1;
+        }
+        p += 16;
+    }
+#endif
+
+    for (; p < end; p++)
+        if (p[0] == first && p[needleLength - 1] == last &&
+            matchesInner(p, needle, needleLength))
+            return p - haystack;
+    return -1;
+}
+
 // ============= VALUE METHODS =============
 
 // NUMBER
@@ -43,30 +124,161 @@ static Value numberMethod_ToHex(int argCount, Value *args)
             "Expect an integer, not '%s'.", valueToString(self)
         ));
 
-    char *buf = formatString("0x%x", (int)AS_NUMBER(self));
-    return OBJ_VAL(copyString(buf, strlen(buf)));
+    char buf[NUMBER_BUFFER_SIZE];
+    int length = snprintf(buf, sizeof(buf), "0x%x", (int)AS_NUMBER(self));
+    return OBJ_VAL(copyUninternedString(buf, length));
 }
 
 // ============= OBJECT METHODS =============
 
 // STRING
+// returns null if the string is not a number
 static Value stringMethod_ToNum(int argCount, Value *args)
 {
-    char *cropped;
-    double number = strtod(AS_CSTRING(self), &cropped);
+    double number;
+    if (!parseNumber(AS_CSTRING(self), AS_STRING(self)->length, &number))
+        return NULL_VAL;
     return NUMBER_VAL(number);
 }
 static Value stringMethod_Split(int argCount, Value *args)
 {
-    char *string = AS_CSTRING(self);
+    // argCount includes the receiver
+    if (argCount > 2)
+        return methodRuntimeError(formatString(
+            "Expected 0 or 1 arguments but got %d.", argCount - 1));
+    if (argCount == 2 && !checkArg(args[0], VAL_OBJ, OBJ_STRING))
+        return methodRuntimeError(formatString(
+            "Expected a string separator, not '%s'.", valueToString(args[0])));
+
+    ObjString *string = AS_STRING(self);
+    ObjString *sep = argCount == 2 ? AS_STRING(args[0]) : NULL;
+    bool chars = sep == NULL || sep->length == 0;
+
+    // count the pieces first so the array is allocated once
+    int count = string->length;
+    if (!chars)
+    {
+        count = 1;
+        for (int i = 0; (i = findSubstring(string->chars, string->length,
+                sep->chars, sep->length, i)) != -1; i += sep->length)
+            count++;
+    }
+
     ObjArray *array = newArray();
+    push(OBJ_VAL(array));
+    if (count > 0)
+    {
+        array->array.values = GROW_ARRAY(Value, NULL, 0, count);
+        array->array.capacity = count;
+    }
 
-    for (int i = 0; i < strlen(string); i++)
+    // every part is a new allocation that can promote the array,
+    // so each store needs its own barrier
+    if (chars)
+    {
+        for (int i = 0; i < string->length; i++)
+        {
+            writeValueArray(&array->array, OBJ_VAL(
+                copyUninternedString(&string->chars[i], 1)));
+            writeBarrier((Obj *)array);
+        }
+    }
+    else
+    {
+        int begin = 0, next;
+        while ((next = findSubstring(string->chars, string->length,
+                sep->chars, sep->length, begin)) != -1)
+        {
+            writeValueArray(&array->array, OBJ_VAL(
+                copyUninternedString(&string->chars[begin], next - begin)));
+            writeBarrier((Obj *)array);
+            begin = next + sep->length;
+        }
         writeValueArray(&array->array, OBJ_VAL(
-            copyString(formatString("%c", string[i]), 2)));
+            copyUninternedString(&string->chars[begin], string->length - begin)));
+        writeBarrier((Obj *)array);
+    }
 
+    pop();
     return OBJ_VAL(array);
 }
+static Value stringMethod_Slice(int argCount, Value *args)
+{
+    ObjString *string = AS_STRING(self);
+    int bounds[2];
+
+    for (int i = 0; i < 2; i++)
+    {
+        if (!checkArg(args[i], VAL_NUMBER, 0))
+            return methodRuntimeError(formatString(
+                "Slice bounds should be integers, not '%s'.", valueToString(args[i])));
+
+        // range checked before the cast, which is undefined for doubles
+        // that do not fit (NaN fails the check as well)
+        double bound = AS_NUMBER(args[i]);
+        if (!(bound >= -string->length && bound <= string->length))
+            return methodRuntimeError(formatString(
+                "Slice bound %s is out of range for string of length %d.",
+                valueToString(args[i]), string->length));
+        if ((int)bound != bound)
+            return methodRuntimeError(formatString(
+                "Slice bounds should be integers, not '%s'.", valueToString(args[i])));
+
+        // negative bounds count from the end
+        bounds[i] = (int)bound;
+        if (bounds[i] < 0)
+            bounds[i] += string->length;
+    }
+
+    if (bounds[0] < 0 || bounds[0] > bounds[1] || bounds[1] > string->length)
+        return methodRuntimeError(formatString(
+            "Invalid slice [%d, %d] for string of length %d.",
+            bounds[0], bounds[1], string->length));
+
+    if (bounds[0] == 0 && bounds[1] == string->length)
+        return self;
+    return OBJ_VAL(copyUninternedString(&string->chars[bounds[0]], bounds[1] - bounds[0]));
+}
+static Value stringMethod_IndexOf(int argCount, Value *args)
+{
+    if (!checkArg(args[0], VAL_OBJ, OBJ_STRING))
+        return methodRuntimeError(formatString(
+            "Expected a string argument, not '%s'.", valueToString(args[0])));
+
+    ObjString *string = AS_STRING(self);
+    ObjString *needle = AS_STRING(args[0]);
+    int index = findSubstring(string->chars, string->length, needle->chars, needle->length, 0);
+
+    // same convention as the array method Find
+    if (index == -1)
+        return BOOL_VAL(false);
+    return NUMBER_VAL(index);
+}
+static Value stringMethod_StartsWith(int argCount, Value *args)
+{
+    if (!checkArg(args[0], VAL_OBJ, OBJ_STRING))
+        return methodRuntimeError(formatString(
+            "Expected a string argument, not '%s'.", valueToString(args[0])));
+
+    ObjString *string = AS_STRING(self);
+    ObjString *prefix = AS_STRING(args[0]);
+    return BOOL_VAL(prefix->length <= string->length &&
+                    memcmp(string->chars, prefix->chars, prefix->length) == 0);
+}
+static Value stringMethod_Trim(int argCount, Value *args)
+{
+    ObjString *string = AS_STRING(self);
+    int begin = 0, end = string->length;
+
+    while (begin < end && isspace((unsigned char)string->chars[begin]))
+        begin++;
+    while (end > begin && isspace((unsigned char)string->chars[end - 1]))
+        end--;
+
+    if (begin == 0 && end == string->length)
+        return self;
+    return OBJ_VAL(copyUninternedString(&string->chars[begin], end - begin));
+}
 static Value stringMethod_Replace(int argCount, Value *args)
 {
     // check the two args
@@ -77,58 +289,54 @@ static Value stringMethod_Replace(int argCount, Value *args)
             valueToString(args[0]), valueToString(args[1])
         ));
 
-    char *orig = AS_CSTRING(self);
-    char *rep = AS_CSTRING(args[0]);
-    char *with = AS_CSTRING(args[1]);
-
-    // source: https://stackoverflow.com/questions/779875/what-function-is-to-replace-a-substring-from-a-string-in-c
-    // answer by: https://stackoverflow.com/users/44065/jmucchiello
-
-    char *result;  // the return string
-    char *ins;     // the next insert point
-    char *tmp;     // varies
-    int len_rep;   // length of rep (the string to remove)
-    int len_with;  // length of with (the string to replace rep with)
-    int len_front; // distance between rep and end of last rep
-    int count;     // number of replacements
-
-    // sanity checks and initialization
-    if (!orig || !rep)
-        return OBJ_VAL(copyString(orig, strlen(orig)));
-    len_rep = strlen(rep);
-    if (len_rep == 0)
-        return OBJ_VAL(copyString(orig, strlen(orig))); // empty rep causes infinite loop during count
-    if (!with)
-        with = "";
-    len_with = strlen(with);
+    ObjString *orig = AS_STRING(self);
+    ObjString *rep = AS_STRING(args[0]);
+    ObjString *with = AS_STRING(args[1]);
+
+    // an empty rep would match everywhere
+    if (rep->length == 0)
+        return self;
 
     // count the number of replacements needed
-    ins = orig;
-    for (count = 0; (tmp = strstr(ins, rep)); ++count)
-    {
-        ins = tmp + len_rep;
-    }
+    int count = 0;
+    for (int i = 0; (i = findSubstring(orig->chars, orig->length,
+            rep->chars, rep->length, i)) != -1; i += rep->length)
+        count++;
 
-    tmp = result = malloc(strlen(orig) + (len_with - len_rep) * count + 1);
+    // strings are immutable, so nothing to replace means nothing to copy
+    if (count == 0)
+        return self;
 
-    if (!result)
-        return OBJ_VAL(copyString(orig, strlen(orig)));
+    int64_t length = orig->length + (int64_t)(with->length - rep->length) * count;
+    if (length > INT_MAX)
+        return methodRuntimeError(formatString(
+            "Replace result of %lld characters is too long.", (long long)length));
+
+    // results short enough to be shared are built on the stack
+    char buf[SHORT_STRING_MAX + 1];
+    ObjString *string = NULL;
+    char *tmp = buf;
+    if (length > SHORT_STRING_MAX)
+    {
+        string = allocateString((int)length);
+        tmp = string->chars;
+    }
 
-    // first time through the loop, all the variable are set correctly
-    // from here on,
-    //    tmp points to the end of the result string
-    //    ins points to the next occurrence of rep in orig
-    //    orig points to the remainder of orig after "end of rep"
-    while (count--)
+    // copy the part in front of each match, then the replacement
+    int begin = 0, next;
+    while ((next = findSubstring(orig->chars, orig->length, rep->chars, rep->length, begin)) != -1)
     {
-        ins = strstr(orig, rep);
-        len_front = ins - orig;
-        tmp = strncpy(tmp, orig, len_front) + len_front;
-        tmp = strcpy(tmp, with) + len_with;
-        orig += len_front + len_rep; // move to next "end of rep"
+        memcpy(tmp, &orig->chars[begin], next - begin);
+        tmp += next - begin;
+        memcpy(tmp, with->chars, with->length);
+        tmp += with->length;
+        begin = next + rep->length;
     }
-    strcpy(tmp, orig);
-    return OBJ_VAL(copyString(result, strlen(result)));
+    memcpy(tmp, &orig->chars[begin], orig->length - begin);
+
+    if (string == NULL)
+        return OBJ_VAL(copyUninternedString(buf, (int)length));
+    return OBJ_VAL(string);
 }
 
 // ARRAY
@@ -153,15 +361,19 @@ static Value arrayMethod_Reverse(int argCount, Value *args)
     
     for (int i = 0; i < array->count; i++)
         array->values[i] = copy.values[copy.count - i - 1];
+    arrayMoveBarrier(AS_ARRAY(self));
 
     return self;
 }
 static Value arrayMethod_Copy(int argCount, Value *args)
 {
-    ValueArray oldarray = AS_ARRAY(self)->array;
+    ObjArray *oldarray = AS_ARRAY(self);
     ObjArray *newarray = newArray();
-    for(int i = 0; i < oldarray.count; i++)
-        writeValueArray(&newarray->array, oldarray.values[i]);
+    push(OBJ_VAL(newarray));
+    for(int i = 0; i < oldarray->array.count; i++)
+        writeValueArray(&newarray->array, oldarray->array.values[i]);
+    writeBarrier((Obj *)newarray);
+    pop();
     return OBJ_VAL(newarray);
 }
 static Value arrayMethod_Prepend(int argCount, Value *args)
@@ -171,6 +383,7 @@ static Value arrayMethod_Prepend(int argCount, Value *args)
     if (array->count == 0)
     {
         writeValueArray(array, args[0]);
+        writeValueBarrier(AS_OBJ(self), args[0]);
         return NULL_VAL;
     }
 
@@ -181,12 +394,14 @@ static Value arrayMethod_Prepend(int argCount, Value *args)
         array->values[i + 1] = array->values[i];
     // then set first to new value
     array->values[0] = args[0];
+    writeValueBarrier(AS_OBJ(self), args[0]);
     return self;
 }
 static Value arrayMethod_Append(int argCount, Value *args)
 {
     ValueArray *array = &AS_ARRAY(self)->array;
     writeValueArray(array, args[0]);
+    writeValueBarrier(AS_OBJ(self), args[0]);
     return self;
 }
 static Value arrayMethod_Insert(int argCount, Value *args)
@@ -220,6 +435,7 @@ static Value arrayMethod_Insert(int argCount, Value *args)
 
     // set new value
     array->values[index] = args[1];
+    writeValueBarrier(AS_OBJ(self), args[1]);
     return self;
 }
 static Value arrayMethod_Find(int argCount, Value *args)
@@ -249,6 +465,7 @@ static Value arrayMethod_Remove(int argCount, Value *args)
             array->count--;
         }
     } while (i != array->count);
+    arrayMoveBarrier(AS_ARRAY(self));
 
     return self;
 }
@@ -263,20 +480,113 @@ static Value arrayMethod_Join(int argCount, Value *args)
 {
     ValueArray array = AS_ARRAY(self)->array;
 
-    char *ret = "";
+    // size the buffer up front: strings exactly, anything else roughly
+    int64_t length = 0;
+    for (int i = 0; i < array.count; i++)
+        length += IS_STRING(array.values[i]) ? AS_STRING(array.values[i])->length : 8;
+
+    ObjStringBuilder *builder = newStringBuilder();
+    push(OBJ_VAL(builder));
+    stringBuilderReserve(builder, length > INT_MAX ? INT_MAX : (int)length);
+
     for (int i = 0; i < array.count; i++)
-	{
-		ret = formatString("%s%s",
-			ret, valueToString(array.values[i]));
-	}
-    return OBJ_VAL(copyString(ret, strlen(ret)));
+    {
+        if (!stringBuilderAppendValue(builder, array.values[i]))
+        {
+            pop();
+            return methodRuntimeError(formatString(
+                "Join result of more than %d characters is too long.", INT_MAX));
+        }
+    }
+
+    ObjString *string = stringBuilderToString(builder);
+    pop();
+    return OBJ_VAL(string);
+}
+
+// STRING BUILDER
+static Value stringBuilderTooLong()
+{
+    return methodRuntimeError(formatString(
+        "StringBuilder text of more than %d characters is too long.", INT_MAX));
+}
+static Value stringBuilderMethod_Append(int argCount, Value *args)
+{
+    if (!stringBuilderAppendValue(AS_STRING_BUILDER(self), args[0]))
+        return stringBuilderTooLong();
+    return self;
+}
+static Value stringBuilderMethod_AppendLine(int argCount, Value *args)
+{
+    // argCount includes the receiver
+    if (argCount > 2)
+        return methodRuntimeError(formatString(
+            "Expected 0 or 1 arguments but got %d.", argCount - 1));
+
+    ObjStringBuilder *builder = AS_STRING_BUILDER(self);
+    if (argCount == 2 && !stringBuilderAppendValue(builder, args[0]))
+        return stringBuilderTooLong();
+    if (!stringBuilderAppend(builder, "\n", 1))
+        return stringBuilderTooLong();
+    return self;
+}
+static Value stringBuilderMethod_Length(int argCount, Value *args)
+{
+    return NUMBER_VAL(AS_STRING_BUILDER(self)->length);
+}
+static Value stringBuilderMethod_ToStr(int argCount, Value *args)
+{
+    return OBJ_VAL(stringBuilderToString(AS_STRING_BUILDER(self)));
+}
+
+
+// MAP
+static Value mapMethod_Get(int argCount, Value *args)
+{
+    Value value;
+    if (!valueTableGet(&AS_MAP(self)->table, args[0], &value))
+        return NULL_VAL;
+    return value;
+}
+static Value mapMethod_Set(int argCount, Value *args)
+{
+    valueTableSet(&AS_MAP(self)->table, args[0], args[1]);
+    writeValueBarrier(AS_OBJ(self), args[0]);
+    writeValueBarrier(AS_OBJ(self), args[1]);
+    return self;
+}
+static Value mapMethod_Has(int argCount, Value *args)
+{
+    Value value;
+    return BOOL_VAL(valueTableGet(&AS_MAP(self)->table, args[0], &value));
+}
+static Value mapMethod_Delete(int argCount, Value *args)
+{
+    return BOOL_VAL(valueTableDelete(&AS_MAP(self)->table, args[0]));
+}
+static Value mapMethod_Keys(int argCount, Value *args)
+{
+    return OBJ_VAL(mapKeys(AS_MAP(self)));
+}
+static Value mapMethod_Values(int argCount, Value *args)
+{
+    return OBJ_VAL(mapValues(AS_MAP(self)));
+}
+static Value mapMethod_Length(int argCount, Value *args)
+{
+    return NUMBER_VAL(AS_MAP(self)->table.count);
 }
 
 
 // ============= ============= =============
 
+// an arity of -1 lets the method check its argCount itself
 static void createMethod(ValueArray *array, const char *name, NativeFn method, int arity)
-{ writeValueArray(array, OBJ_VAL(newNative(method, arity + 1, name))); }
+{
+    push(OBJ_VAL(newNative(method, arity == -1 ? -1 : arity + 1, name)));
+    writeValueArray(array, vm.stackTop[-1]);
+    pop();
+}
 
 void defineAllMethods()
 {
@@ -284,7 +594,11 @@ void defineAllMethods()
     createMethod(&numberMethods, "ToHex",  numberMethod_ToHex,  0);
 
     createMethod(&stringMethods, "ToNum",  stringMethod_ToNum,  0);
-    createMethod(&stringMethods, "Split",  stringMethod_Split,  0);
+    createMethod(&stringMethods, "Split",  stringMethod_Split, -1);
+    createMethod(&stringMethods, "Slice",  stringMethod_Slice,  2);
+    createMethod(&stringMethods, "IndexOf",stringMethod_IndexOf,1);
+    createMethod(&stringMethods, "StartsWith",stringMethod_StartsWith,1);
+    createMethod(&stringMethods, "Trim",   stringMethod_Trim,   0);
     createMethod(&stringMethods, "Replace",stringMethod_Replace,2);
     
     createMethod(&arrayMethods,  "Length", arrayMethod_Length,  0);
@@ -298,4 +612,17 @@ void defineAllMethods()
     createMethod(&arrayMethods,  "Remove", arrayMethod_Remove,  1);
     createMethod(&arrayMethods,  "Pop",    arrayMethod_Pop,     0);
     createMethod(&arrayMethods,  "Join",   arrayMethod_Join,    0);
+
+    createMethod(&stringBuilderMethods, "Append",     stringBuilderMethod_Append,     1);
+    createMethod(&stringBuilderMethods, "AppendLine", stringBuilderMethod_AppendLine, -1);
+    createMethod(&stringBuilderMethods, "Length",     stringBuilderMethod_Length,     0);
+    createMethod(&stringBuilderMethods, "ToStr",      stringBuilderMethod_ToStr,      0);
+
+    createMethod(&mapMethods,    "Get",    mapMethod_Get,       1);
+    createMethod(&mapMethods,    "Set",    mapMethod_Set,       2);
+    createMethod(&mapMethods,    "Has",    mapMethod_Has,       1);
+    createMethod(&mapMethods,    "Delete", mapMethod_Delete,    1);
+    createMethod(&mapMethods,    "Keys",   mapMethod_Keys,      0);
+    createMethod(&mapMethods,    "Values", mapMethod_Values,    0);
+    createMethod(&mapMethods,    "Length", mapMethod_Length,    0);
 }
\ No newline at end of file
@@ -7,6 +7,7 @@
 #include "natives.h"
 #include "common.h"
 #include "mem.h"
+#include "number.h"
 #include "vm.h"
 #include "value.h"
 
@@ -61,8 +62,15 @@ static Value typeNative(int argCount, Value *args)
 
 static Value strNative(int argCount, Value *args)
 {
+    if (IS_NUMBER(args[0]))
+    {
+        char buffer[NUMBER_BUFFER_SIZE];
+        int length = formatNumber(AS_NUMBER(args[0]), buffer);
+        return OBJ_VAL(copyUninternedString(buffer, length));
+    }
+
     char *str = valueToString(args[0]);
-    return OBJ_VAL(copyString(str, strlen(str)));
+    return OBJ_VAL(copyUninternedString(str, strlen(str)));
 }
 
 static Value boolNative(int argCount, Value *args)
@@ -70,6 +78,88 @@ static Value boolNative(int argCount, Value *args)
     return BOOL_VAL(!isFalsey(args[0]));
 }
 
+static Value stringBuilderNative(int argCount, Value *args)
+{
+    return OBJ_VAL(newStringBuilder());
+}
+
+// sets map[key] to value, keeping both safe from the GC
+static void setStat(ObjMap *map, const char *key, Value value)
+{
+    push(value);
+    push(OBJ_VAL(copyString(key, strlen(key))));
+    valueTableSet(&map->table, vm.stackTop[-1], value);
+    writeValueBarrier((Obj *)map, vm.stackTop[-1]);
+    writeValueBarrier((Obj *)map, value);
+    pop();
+    pop();
+}
+
+// returns the GC counters as a map. "liveBytes" maps object types to
+// the bytes their live objects take
+static Value gcStatsNative(int argCount, Value *args)
+{
+    // building the map may collect, report what was before
+    GcStats stats = vm.gcStats;
+    size_t bytesAllocated = vm.bytesAllocated;
+    size_t nextGC = vm.nextGC;
+    int strings = vm.strings.count;
+    int stringSlots = vm.strings.capacity;
+
+    ObjMap *map = newMap();
+    push(OBJ_VAL(map));
+    setStat(map, "minorCollections", NUMBER_VAL(stats.minorCollections));
+    setStat(map, "fullCollections", NUMBER_VAL(stats.fullCollections));
+    setStat(map, "steps", NUMBER_VAL(stats.steps));
+    setStat(map, "pauseTotal", NUMBER_VAL(stats.pauseTotal * 1e3));
+    setStat(map, "pauseMax", NUMBER_VAL(stats.pauseMax * 1e3));
+    setStat(map, "bytesFreed", NUMBER_VAL(stats.bytesFreed));
+    setStat(map, "bytesAllocated", NUMBER_VAL(bytesAllocated));
+    setStat(map, "nextGC", NUMBER_VAL(nextGC));
+    setStat(map, "internedStrings", NUMBER_VAL(strings));
+    setStat(map, "internSlots", NUMBER_VAL(stringSlots));
+
+    ObjMap *types = newMap();
+    setStat(map, "liveBytes", OBJ_VAL(types));
+    for (int i = 0; i < OBJ_TYPE_COUNT; i++)
+    {
+        if (stats.typeBytes[i] != 0)
+            setStat(types, objTypeName(i), NUMBER_VAL(stats.typeBytes[i]));
+    }
+
+    pop();
+    return OBJ_VAL(map);
+}
+
+// compacts the heap and returns the bytes given back to the OS. safe
+// here, as the call returns right after and nothing holds on to objects
+static Value compactHeapNative(int argCount, Value *args)
+{
+    return NUMBER_VAL(compactHeap());
+}
+
+// Memoize(fn) or Memoize(fn, maxEntries): fn wrapped in a callable
+// that remembers what it returned for which arguments. with a bound
+// the least recently used results are forgotten first
+static Value memoizeNative(int argCount, Value *args)
+{
+    if (argCount != 1 && argCount != 2)
+        return nativeRuntimeError("Expect 1 or 2 arguments.");
+    if (!checkArg(args[0], VAL_OBJ, OBJ_CLOSURE))
+        return nativeRuntimeError("Expected a function to memoize.");
+
+    int maxEntries = 0;
+    if (argCount == 2)
+    {
+        if (!checkArg(args[1], VAL_NUMBER, 0) || AS_NUMBER(args[1]) < 1 ||
+            AS_NUMBER(args[1]) > INT32_MAX ||
+            AS_NUMBER(args[1]) != (int)AS_NUMBER(args[1]))
+            return nativeRuntimeError("Expected a positive whole number of entries.");
+        maxEntries = (int)AS_NUMBER(args[1]);
+    }
+    return OBJ_VAL(newMemo(AS_CLOSURE(args[0]), maxEntries));
+}
+
 // yoinked from https://github.com/valkarias
 static Value inputNative(int argCount, Value *args)
 {
@@ -113,14 +203,9 @@ static Value inputNative(int argCount, Value *args)
         }
     }
 
-    if (length != currentSize)
-    {
-        line = GROW_ARRAY(char, line, currentSize, length + 1);
-    }
-
-    line[length] = '\0';
-
-    return OBJ_VAL(takeString(line, length));
+    ObjString *string = copyUninternedString(line, length);
+    FREE_ARRAY(char, line, currentSize);
+    return OBJ_VAL(string);
 }
 // ---------------------------
 
@@ -134,4 +219,8 @@ void defineNatives()
     defineNativeFn("TypeOf",   typeNative,  1);
     defineNativeFn("Str",      strNative,   1);
     defineNativeFn("Bln",      boolNative,  1);
+    defineNativeFn("StringBuilder", stringBuilderNative, 0);
+    defineNativeFn("GcStats",  gcStatsNative, 0);
+    defineNativeFn("CompactHeap", compactHeapNative, 0);
+    defineNativeFn("Memoize",  memoizeNative, -1);
 }
\ No newline at end of file
@@ -4,10 +4,15 @@
 #pragma diag_suppress 29
 #endif
 
+#include <limits.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
+#include "hash.h"
 #include "mem.h"
+#include "number.h"
+#include "slab.h"
 #include "object.h"
 #include "value.h"
 #include "table.h"
@@ -17,15 +22,16 @@
 #define ALLOCATE_OBJ(type, objectType) \
 	(type *)allocateObject(sizeof(type), objectType)
 
-// helper for ALLOCATE_OBJ
-static Obj *allocateObject(size_t size, ObjType type)
+// links already allocated memory into the object list as an Obj
+static Obj *initObject(Obj *object, size_t size, ObjType type)
 {
-	Obj *object = (Obj *)reallocate(NULL, 0, size);
 	object->type = type;
-	object->isMarked = false;
+	object->mark = !vm.markBit;
+	object->isRemembered = false;
+	vm.gcStats.typeBytes[type] += size;
 
-	object->next = vm.objects;
-	vm.objects = object;
+	object->next = vm.youngObjects;
+	vm.youngObjects = object;
 
 #ifdef DEBUG_LOG_GC
 	printf(" -- %p allocate %zu for %d\n", (void *)object, size, type);
@@ -34,6 +40,12 @@ static Obj *allocateObject(size_t size, ObjType type)
 	return object;
 }
 
+// helper for ALLOCATE_OBJ
+static Obj *allocateObject(size_t size, ObjType type)
+{
+	return initObject((Obj *)allocateObjectMemory(size), size, type);
+}
+
 
 
 // allocates and returns a new bound method
@@ -92,10 +104,14 @@ ObjClosure *newClosure(ObjFunction *function)
 // allocates and returns a new native function
 ObjNative *newNative(NativeFn function, int arity, const char *name)
 {
+	ObjString *nameString = copyString(name, strlen(name));
+	push(OBJ_VAL(nameString)); // keep name safe from GC
+
 	ObjNative *native = ALLOCATE_OBJ(ObjNative, OBJ_NATIVE);
 	native->function = function;
 	native->arity = arity;
-	native->name = copyString(name, strlen(name));
+	native->name = nameString;
+	pop();
 	return native;
 }
 
@@ -108,7 +124,7 @@ ObjFunction *newFunction()
 	function->arity = 0;
 	function->upvalueCount = 0;
 	function->name = NULL;
-	function->returnType = *newDataType(NULL_VAL, true);
+	function->returnType = anyType();
 	initValueArray(&function->argTypes);
 	initChunk(&function->chunk);
 	return function;
@@ -157,12 +173,16 @@ static char *dataTypeToString(Value value);
 
 ObjDataType *newDataType(Value value, bool isAny)
 {
+	push(value); // the described value may be unreachable otherwise
 	ObjDataType *type = ALLOCATE_OBJ(ObjDataType, OBJ_DATA_TYPE);
+	pop();
 	type->valueType = value.type;
 	type->objType = IS_OBJ(value) ? AS_OBJ(value)->type : 0;
 	type->isAny = isAny;
 	type->invalid = false;
-	type->classType = IS_INSTANCE(value) ? *AS_INSTANCE(value)->klass : *newClass(copyString("",0));
+	// only the class name is ever read, so no class is allocated for it
+	type->classType = IS_INSTANCE(value) ? *AS_INSTANCE(value)->klass
+		: (ObjClass){.name = copyString("", 0)};
 	return type; 
 }
 
@@ -184,39 +204,57 @@ Value callDataType(ObjDataType *callee, int argCount, Value *args)
 	default: break;
 	}
 
-	Value err = OBJ_VAL(copyString(errmsg, strlen(errmsg)));
+	Value err = OBJ_VAL(copyUninternedString(errmsg, strlen(errmsg)));
 	err.type = -1;
 	return err;
 }
 
-ObjDataType *dataTypeFromString(const char *str)
+// types the compiler works with are plain values like these. they
+// go on the heap only when stored in a chunk, see typeConstant()
+ObjDataType anyType()
 {
-	ObjDataType *type = newDataType(NULL_VAL, true);
-	
-	// printf("\n\n\n");
+	ObjDataType type = {0};
+	type.isAny = true;
+	type.valueType = VAL_NULL;
+	type.classType.name = copyString("", 0); // shared, not allocated
+	return type;
+}
+
+// the type of objects of the given type
+ObjDataType objectType(ObjType objType)
+{
+	ObjDataType type = anyType();
+	type.isAny = false;
+	type.valueType = VAL_OBJ;
+	type.objType = objType;
+	return type;
+}
 
-	if (strcmp(str, "Any")==0) return type;
-	type->isAny = false;
+// the type named chars, invalid if there is none
+ObjDataType dataTypeFromString(const char *chars, int length)
+{
+	ObjDataType type = anyType();
+	if (length == 3 && memcmp(chars, "Any", 3) == 0)
+		return type;
+	type.isAny = false;
 
 	// check value types	
-	for(type->valueType = VAL_BOOL; type->valueType < VAL_OBJ; type->valueType++)
+	for (type.valueType = VAL_BOOL; type.valueType < VAL_OBJ; type.valueType++)
 	{
-		// printf("checking if %s == %s (%d)\n", str, dataTypeToString(OBJ_VAL(type)), type->valueType);
-		if (strcmp(str, dataTypeToString(OBJ_VAL(type))) == 0)
+		const char *name = dataTypeToString(OBJ_VAL(&type));
+		if ((int)strlen(name) == length && memcmp(chars, name, length) == 0)
 			return type;
 	}
 
-	// printf("checking obj types\n");
-
 	// check object types	
-	for(type->objType = OBJ_ARRAY; type->objType <= OBJ_MODULE; type->objType++)
+	for (type.objType = OBJ_ARRAY; type.objType <= OBJ_MAP; type.objType++)
 	{
-		// printf("checking if %s == %s (%d)\n", str, dataTypeToString(OBJ_VAL(type)), type->objType);
-		if (strcmp(str, dataTypeToString(OBJ_VAL(type))) == 0)
+		const char *name = dataTypeToString(OBJ_VAL(&type));
+		if ((int)strlen(name) == length && memcmp(chars, name, length) == 0)
 			return type;
 	}
 
-	type->invalid = true;
+	type.invalid = true;
 	return type;
 }
 
@@ -225,69 +263,355 @@ ObjDataType *dataTypeFromString(const char *str)
 ObjModule *newModule(const char *name, const char *path)
 {
 	ObjModule *module = ALLOCATE_OBJ(ObjModule, OBJ_MODULE);
-	module->name = *copyString(name, strlen(name));
-	module->path = *copyString(path, strlen(path));
+	module->name = NULL;
+	module->path = NULL;
 	initTable(&module->fields);
 	initTable(&module->fieldsTypes);
+
+	push(OBJ_VAL(module)); // keep module safe from GC
+	module->name = copyString(name, strlen(name));
+	module->path = copyString(path, strlen(path));
+	writeBarrier((Obj *)module);
+	pop();
 	return module;
 }
 
 
-// allocates a ObjString
-static ObjString *allocateString(char *chars, int length, uint32_t hash)
+
+// size of a builder buffer block with room for capacity chars
+#define BUILDER_BLOCK_SIZE(capacity) (sizeof(ObjString) + (capacity) + 1)
+
+ObjStringBuilder *newStringBuilder()
 {
-	ObjString *string = ALLOCATE_OBJ(ObjString, OBJ_STRING);
-	string->length = length;
-	string->chars = chars;
-	string->hash = hash;
+	ObjStringBuilder *builder = ALLOCATE_OBJ(ObjStringBuilder, OBJ_STRING_BUILDER);
+	builder->buffer = NULL;
+	builder->length = 0;
+	builder->capacity = 0;
+	builder->string = NULL;
+	return builder;
+}
 
-	push(OBJ_VAL(string)); // keep string safe from GC
-	tableSet(&vm.strings, string, NULL_VAL);
-	pop();
+// makes room for extra more chars, growing the buffer geometrically.
+// false if the text would pass INT_MAX chars. can trigger a GC, so the
+// builder has to be reachable
+bool stringBuilderReserve(ObjStringBuilder *builder, int extra)
+{
+	if (extra > INT_MAX - builder->length)
+		return false;
+	int needed = builder->length + extra;
+	if (builder->buffer != NULL && needed <= builder->capacity)
+		return true;
+
+	int capacity = builder->capacity < 8 ? 8 : builder->capacity;
+	while (capacity < needed)
+		capacity = capacity > INT_MAX / 2 ? INT_MAX : capacity * 2;
+
+	if (builder->buffer == NULL)
+	{
+		builder->buffer = (ObjString *)reallocate(NULL, 0, BUILDER_BLOCK_SIZE(capacity));
+		// the text was handed to a string by ToStr(), take a copy back
+		if (builder->string != NULL)
+			memcpy(builder->buffer->chars, builder->string->chars, builder->length);
+	}
+	else
+		builder->buffer = (ObjString *)reallocate(builder->buffer,
+			BUILDER_BLOCK_SIZE(builder->capacity), BUILDER_BLOCK_SIZE(capacity));
+
+	builder->capacity = capacity;
+	builder->string = NULL;
+	return true;
+}
+
+bool stringBuilderAppend(ObjStringBuilder *builder, const char *chars, int length)
+{
+	if (!stringBuilderReserve(builder, length))
+		return false;
+	memcpy(builder->buffer->chars + builder->length, chars, length);
+	builder->length += length;
+	return true;
+}
+
+// appends a value the way Print would show it
+bool stringBuilderAppendValue(ObjStringBuilder *builder, Value value)
+{
+	if (IS_STRING(value))
+	{
+		// reserving may run a GC, the string is rooted by the caller
+		return stringBuilderAppend(builder, AS_CSTRING(value), AS_STRING(value)->length);
+	}
+	else if (IS_NUMBER(value))
+	{
+		char buffer[NUMBER_BUFFER_SIZE];
+		int length = formatNumber(AS_NUMBER(value), buffer);
+		return stringBuilderAppend(builder, buffer, length);
+	}
+	else
+	{
+		char *chars = valueToString(value);
+		return stringBuilderAppend(builder, chars, strlen(chars));
+	}
+}
+
+// returns the built text as a string. the buffer is shrunk to fit and
+// becomes the string itself, so longer text is never copied
+ObjString *stringBuilderToString(ObjStringBuilder *builder)
+{
+	if (builder->string != NULL)
+		return builder->string;
+
+	if (builder->length <= SHORT_STRING_MAX)
+		return copyUninternedString(
+			builder->buffer != NULL ? builder->buffer->chars : "", builder->length);
+
+	ObjString *string;
+	if (BUILDER_BLOCK_SIZE(builder->length) <= SLAB_MAX_SIZE)
+	{
+		// small strings have to live in a slab, copy the text over.
+		// the builder is rooted by the caller and keeps the buffer
+		string = allocateString(builder->length);
+		memcpy(string->chars, builder->buffer->chars, builder->length);
+		reallocate(builder->buffer, BUILDER_BLOCK_SIZE(builder->capacity), 0);
+	}
+	else
+	{
+		// shrinking never triggers a GC
+		string = (ObjString *)reallocate(builder->buffer,
+			BUILDER_BLOCK_SIZE(builder->capacity), BUILDER_BLOCK_SIZE(builder->length));
+		initObject((Obj *)string, BUILDER_BLOCK_SIZE(builder->length), OBJ_STRING);
+		string->length = builder->length;
+		string->hash = 0;
+		string->isHashed = false;
+		string->isInterned = false;
+		string->chars[string->length] = '\0';
+	}
+
+	builder->buffer = NULL;
+	builder->capacity = 0;
+	builder->string = string;
+	writeBarrier((Obj *)builder);
 	return string;
 }
 
-static uint32_t hashString(const char *key, int length)
+ObjMap *newMap()
 {
-	uint32_t hash = 2166136261u;
-	for (int i = 0; i < length; i++)
+	ObjMap *map = ALLOCATE_OBJ(ObjMap, OBJ_MAP);
+	initValueTable(&map->table);
+	return map;
+}
+
+// copies the map's keys or values into a new array, in slot order
+static ObjArray *mapToArray(ObjMap *map, bool keys)
+{
+	ObjArray *array = newArray();
+	if (map->table.count == 0)
+		return array;
+
+	push(OBJ_VAL(array)); // keep array safe from GC
+	array->array.values = GROW_ARRAY(Value, NULL, 0, map->table.count);
+	array->array.capacity = map->table.count;
+	pop();
+
+	Value key, value;
+	for (int i = 0; i < map->table.capacity; i++)
 	{
-		hash ^= (uint8_t)key[i];
-		hash *= 16777619;
+		if (valueTableEntry(&map->table, i, &key, &value))
+			array->array.values[array->array.count++] = keys ? key : value;
 	}
-	return hash;
+	writeBarrier((Obj *)array);
+	return array;
 }
 
-ObjString *takeString(char *chars, int length)
+ObjArray *mapKeys(ObjMap *map)
 {
-	uint32_t hash = hashString(chars, length);
+	return mapToArray(map, true);
+}
 
-	// check if the string already existed
-	ObjString *interned = tableFindString(
-		&vm.strings, chars, length, hash);
-	if (interned != NULL)
+ObjArray *mapValues(ObjMap *map)
+{
+	return mapToArray(map, false);
+}
+
+// allocates a memoized closure with an empty cache, see memo.c
+ObjMemo *newMemo(ObjClosure *closure, int maxEntries)
+{
+	ObjMemo *memo = ALLOCATE_OBJ(ObjMemo, OBJ_MEMO);
+	memo->closure = closure;
+	memo->arity = closure->function->arity;
+	memo->maxEntries = maxEntries;
+	memo->count = 0;
+	memo->capacity = 0;
+	memo->entries = NULL;
+	memo->keys = NULL;
+	memo->slots = NULL;
+	memo->slotCapacity = 0;
+	memo->newest = memo->oldest = -1;
+	memo->stamp = 0;
+	return memo;
+}
+
+
+// the empty string and every one-byte string are allocated once and
+// shared. they never go through reallocate(), the GC object lists or
+// the intern table, so the GC never frees them
+static ObjString *shortStrings[UINT8_COUNT + 1];
+
+void initShortStrings()
+{
+	if (shortStrings[0] != NULL)
+		return;
+
+	for (int i = 0; i <= UINT8_COUNT; i++)
 	{
-		FREE_ARRAY(char, chars, length + 1);
-		return interned;
+		int length = i < UINT8_COUNT ? 1 : 0;
+		ObjString *string = malloc(sizeof(ObjString) + 2);
+		if (string == NULL)
+			exit(1);
+
+		string->obj.type = OBJ_STRING;
+		string->obj.mark = vm.markBit;
+		string->obj.isRemembered = false;
+		string->obj.next = NULL;
+		string->length = length;
+		string->chars[0] = (char)i;
+		string->chars[length] = '\0';
+		string->hash = hashString(string->chars, length);
+		string->isHashed = true;
+		string->isInterned = true;
+		shortStrings[i] = string;
 	}
+}
 
-	return allocateString(chars, length, hash);
+// returns the shared string for length <= SHORT_STRING_MAX
+static inline ObjString *shortString(const char *chars, int length)
+{
+	return shortStrings[length == 0 ? UINT8_COUNT : (uint8_t)chars[0]];
+}
+
+// allocates an uninterned ObjString with room for length chars
+// (plus the terminator) stored inline. the caller fills in chars
+ObjString *allocateString(int length)
+{
+	ObjString *string = (ObjString *)allocateObject(
+		sizeof(ObjString) + length + 1, OBJ_STRING);
+	string->length = length;
+	string->hash = 0;
+	string->isHashed = false;
+	string->isInterned = false;
+	string->chars[length] = '\0';
+	return string;
+}
+
+// allocates a new string with the given contents and interns it
+static ObjString *allocateInternedString(const char *chars, int length, uint32_t hash)
+{
+	ObjString *string = allocateString(length);
+	memcpy(string->chars, chars, length);
+	string->hash = hash;
+	string->isHashed = true;
+	string->isInterned = true;
+
+	push(OBJ_VAL(string)); // keep string safe from GC
+	tableSet(&vm.strings, string, NULL_VAL);
+	pop();
+	return string;
+}
+
+// like copyString() but takes ownership of (and frees) chars
+ObjString *takeString(char *chars, int length)
+{
+	ObjString *string = copyString(chars, length);
+	FREE_ARRAY(char, chars, length + 1);
+	return string;
 }
 
 // copies a c string to a ObjString and returns that
 ObjString *copyString(const char *chars, int length)
 {
-	char *heapChars = ALLOCATE(char, length + 1);
-	memcpy(heapChars, chars, length);
-	heapChars[length] = '\0';
+	if (length <= SHORT_STRING_MAX)
+		return shortString(chars, length);
+
 	uint32_t hash = hashString(chars, length);
 	
-	// check if the string already existed
+	// check if the string already existed before allocating anything
 	ObjString *interned = tableFindString(
 		&vm.strings, chars, length, hash);
 	if (interned != NULL) return interned;
 
-	return allocateString(heapChars, length, hash);
+	return allocateInternedString(chars, length, hash);
+}
+
+// like takeString() but skips hashing and interning. used for
+// transient strings (concatenation, input, conversions) that
+// are unlikely to ever be used as an identifier or table key
+ObjString *takeUninternedString(char *chars, int length)
+{
+	ObjString *string = copyUninternedString(chars, length);
+	FREE_ARRAY(char, chars, length + 1);
+	return string;
+}
+
+// like copyString() but skips hashing and interning
+ObjString *copyUninternedString(const char *chars, int length)
+{
+	if (length <= SHORT_STRING_MAX)
+		return shortString(chars, length);
+
+	ObjString *string = allocateString(length);
+	memcpy(string->chars, chars, length);
+	return string;
+}
+
+// returns the interned string equal to the given one. an uninterned
+// string without an interned twin gets interned itself
+ObjString *internString(ObjString *string)
+{
+	if (string->isInterned)
+		return string;
+
+	ObjString *interned = findInternedString(string);
+	if (interned != NULL)
+		return interned;
+
+	string->isInterned = true;
+	push(OBJ_VAL(string)); // keep string safe from GC
+	tableSet(&vm.strings, string, NULL_VAL);
+	pop();
+	return string;
+}
+
+// returns the interned string equal to the given one or NULL
+ObjString *findInternedString(ObjString *string)
+{
+	if (string->isInterned)
+		return string;
+	if (string->length <= SHORT_STRING_MAX)
+		return shortString(string->chars, string->length);
+	return tableFindString(&vm.strings, string->chars,
+		string->length, stringHash(string));
+}
+
+// returns the hash of the string, computing it on first use
+uint32_t stringHash(ObjString *string)
+{
+	if (!string->isHashed)
+	{
+		string->hash = hashString(string->chars, string->length);
+		string->isHashed = true;
+	}
+	return string->hash;
+}
+
+// compares two strings by content. interned strings are
+// unique so two of them only match if they're the same object
+bool stringsEqual(ObjString *a, ObjString *b)
+{
+	if (a == b)
+		return true;
+	if ((a->isInterned && b->isInterned) || a->length != b->length)
+		return false;
+	if (a->isHashed && b->isHashed && a->hash != b->hash)
+		return false;
+	return memcmp(a->chars, b->chars, a->length) == 0;
 }
 
 
@@ -300,19 +624,96 @@ static char *functionToString(ObjFunction *function)
 	return formatString("<Fun %s>", function->name->chars);
 }
 
+// text put together from many parts. it lives outside of scratch
+// memory, so the parts can be dropped once appended
+typedef struct
+{
+	char *chars;
+	size_t length;
+	size_t capacity;
+} Text;
+
+static void appendText(Text *text, const char *chars)
+{
+	size_t length = strlen(chars);
+	if (text->length + length + 1 > text->capacity)
+	{
+		while (text->length + length + 1 > text->capacity)
+			text->capacity = GROW_CAPACITY(text->capacity);
+		text->chars = realloc(text->chars, text->capacity);
+		if (text->chars == NULL)
+		{
+			printf("REALLOCATION FAILED\n");
+			exit(1);
+		}
+	}
+	memcpy(text->chars + text->length, chars, length + 1);
+	text->length += length;
+}
+
+// appends an element of an array or map. strings are quoted
+static void appendElement(Text *text, Value value)
+{
+	ScratchMark mark = scratchMark();
+	if (IS_STRING(value))
+	{
+		appendText(text, "\"");
+		appendText(text, AS_CSTRING(value));
+		appendText(text, "\"");
+	}
+	else if (IS_NUMBER(value))
+	{
+		char number[NUMBER_BUFFER_SIZE];
+		formatNumber(AS_NUMBER(value), number);
+		appendText(text, number);
+	}
+	else
+		appendText(text, valueToString(value));
+	scratchReset(mark);
+}
+
+// moves text into scratch memory
+static char *finishText(Text *text)
+{
+	char *chars = scratchAllocate(text->length + 1);
+	memcpy(chars, text->chars, text->length + 1);
+	free(text->chars);
+	return chars;
+}
+
 static char *arrayToString(ObjArray *array)
 {
-	char *ret = "[";
+	Text text = {NULL, 0, 0};
+	appendText(&text, "[");
 	for (int i = 0; i < array->array.count; i++)
 	{
-		ret = formatString("%s%s%s",
-			ret,
-			IS_STRING(array->array.values[i]) ? 
-				formatString("\"%s\"", valueToString(array->array.values[i]))
-				: valueToString(array->array.values[i]),
-			i + 1 != array->array.count ? ", " : "");
+		if (i > 0)
+			appendText(&text, ", ");
+		appendElement(&text, array->array.values[i]);
 	}
-	return formatString("%s]", ret);
+	appendText(&text, "]");
+	return finishText(&text);
+}
+
+static char *mapToString(ObjMap *map)
+{
+	Text text = {NULL, 0, 0};
+	appendText(&text, "{");
+	int printed = 0;
+	Value key, value;
+	for (int i = 0; i < map->table.capacity; i++)
+	{
+		if (!valueTableEntry(&map->table, i, &key, &value))
+			continue;
+
+		if (printed++ > 0)
+			appendText(&text, ", ");
+		appendElement(&text, key);
+		appendText(&text, ": ");
+		appendElement(&text, value);
+	}
+	appendText(&text, "}");
+	return finishText(&text);
 }
 
 static char *dataTypeToString(Value value)
@@ -336,9 +737,12 @@ static char *dataTypeToString(Value value)
 		case OBJ_CLOSURE:       return "Fun";
 		case OBJ_FUNCTION:      return "Fun";
 		case OBJ_NATIVE:        return "Fun";
+		case OBJ_MEMO:          return "Fun";
 		case OBJ_STRING:        return "Str";
 		case OBJ_DATA_TYPE:     return "Type";
 		case OBJ_MODULE:		return "Mdl";
+		case OBJ_STRING_BUILDER: return "StrBuilder";
+		case OBJ_MAP:           return "Map";
 		case OBJ_INSTANCE:		//return "Inst";
 			{
 				if (AS_DATA_TYPE(value)->classType.name->length == 0) return "Inst";
@@ -362,6 +766,9 @@ char *objectToString(Value value)
 	case OBJ_CLASS:		return formatString("<Cls %s>", AS_CLASS(value)->name->chars);
 	case OBJ_CLOSURE:	return functionToString(AS_CLOSURE(value)->function);
 	case OBJ_FUNCTION:	return functionToString(AS_FUNCTION(value));
+	case OBJ_MEMO:
+		return formatString("<memoized Fun %s>",
+			AS_MEMO(value)->closure->function->name->chars);
 	case OBJ_INSTANCE:	return formatString("<%s instance>", AS_INSTANCE(value)->klass->name->chars);
 	case OBJ_NATIVE:	return formatString("<native Fun %s>", AS_NATIVE(value)->name->chars);
 	case OBJ_BOUND_N_M:
@@ -370,12 +777,44 @@ char *objectToString(Value value)
 	case OBJ_STRING:	return AS_CSTRING(value);
 	case OBJ_UPVALUE:	return "<upvalue>";
 	case OBJ_ARRAY:		return arrayToString(AS_ARRAY(value));
+	case OBJ_MAP:		return mapToString(AS_MAP(value));
 	case OBJ_DATA_TYPE:	return dataTypeToString(value);
-	case OBJ_MODULE:	return formatString("<Mdl %s>", AS_MODULE(value)->name.chars);
+	case OBJ_MODULE:	return formatString("<Mdl %s>", AS_MODULE(value)->name->chars);
+	case OBJ_STRING_BUILDER:
+	{
+		ObjStringBuilder *builder = AS_STRING_BUILDER(value);
+		if (builder->string != NULL)
+			return builder->string->chars;
+		return formatString("%.*s", builder->length,
+			builder->buffer != NULL ? builder->buffer->chars : "");
+	}
 	}
 	return "<OBJ-TO-STRING-ERROR>";
 }
 
+// name of an object type in GC statistics
+const char *objTypeName(ObjType type)
+{
+	static const char *names[OBJ_TYPE_COUNT] = {
+		[OBJ_ARRAY] = "Array",
+		[OBJ_BOUND_METHOD] = "BoundMethod",
+		[OBJ_CLASS] = "Class",
+		[OBJ_CLOSURE] = "Closure",
+		[OBJ_FUNCTION] = "Function",
+		[OBJ_INSTANCE] = "Instance",
+		[OBJ_NATIVE] = "Native",
+		[OBJ_BOUND_N_M] = "BoundNative",
+		[OBJ_STRING] = "String",
+		[OBJ_UPVALUE] = "Upvalue",
+		[OBJ_DATA_TYPE] = "DataType",
+		[OBJ_MODULE] = "Module",
+		[OBJ_STRING_BUILDER] = "StringBuilder",
+		[OBJ_MAP] = "Map",
+		[OBJ_MEMO] = "Memo",
+	};
+	return names[type];
+}
+
 // prints an Obj
 void printObject(Value value)
 {
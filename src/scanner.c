@@ -4,11 +4,17 @@
 #include "common.h"
 #include "scanner.h"
 
+// how deep "${...}" can be nested inside each other
+#define MAX_INTERPOLATION_DEPTH 8
+
 typedef struct
 {
 	const char *start;
 	const char *current;
 	int line;
+	// open braces inside each unfinished "${...}"
+	int braces[MAX_INTERPOLATION_DEPTH];
+	int interpolationDepth;
 } Scanner;
 
 Scanner scanner;
@@ -18,6 +24,7 @@ void initScanner(const char *source)
 	scanner.start = source;
 	scanner.current = source;
 	scanner.line = 1;
+	scanner.interpolationDepth = 0;
 }
 
 static bool isAtEnd()
@@ -159,10 +166,24 @@ static Token errorToken(const char *message)
 	return token;
 }
 
+// scans a string (or the rest of one after an interpolated expression).
+// a "${" ends the token early as a TOKEN_INTERPOLATION, the expression
+// tokens follow and the matching '}' continues the string
 static Token string()
 {
 	while (peek() != '"' && !isAtEnd())
 	{
+		if (peek() == '$' && peekNext() == '{')
+		{
+			if (scanner.interpolationDepth == MAX_INTERPOLATION_DEPTH)
+				return errorToken("String interpolation nested too deeply.");
+
+			advance();
+			advance();
+			scanner.braces[scanner.interpolationDepth++] = 0;
+			return makeToken(TOKEN_INTERPOLATION);
+		}
+
 		if (peek() == '\n')
 			scanner.line++;
 		else if (peek() == '\\')
@@ -285,8 +306,22 @@ Token scanToken()
 
 	case '(': return makeToken(TOKEN_LEFT_PAREN);
 	case ')': return makeToken(TOKEN_RIGHT_PAREN);
-	case '{': return makeToken(TOKEN_LEFT_BRACE);
-	case '}': return makeToken(TOKEN_RIGHT_BRACE);
+	case '{':
+		if (scanner.interpolationDepth > 0)
+			scanner.braces[scanner.interpolationDepth - 1]++;
+		return makeToken(TOKEN_LEFT_BRACE);
+	case '}':
+		if (scanner.interpolationDepth > 0)
+		{
+			// the '}' closing a "${" continues its string
+			if (scanner.braces[scanner.interpolationDepth - 1] == 0)
+			{
+				scanner.interpolationDepth--;
+				return string();
+			}
+			scanner.braces[scanner.interpolationDepth - 1]--;
+		}
+		return makeToken(TOKEN_RIGHT_BRACE);
 	case '[': return makeToken(TOKEN_LEFT_B_BRACE);
 	case ']': return makeToken(TOKEN_RIGHT_B_BRACE);
 	case '?': return makeToken(TOKEN_QUESTION);
@@ -0,0 +1,330 @@
+#define _DEFAULT_SOURCE // MAP_ANONYMOUS
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#include "slab.h"
+
+// let AddressSanitizer catch uses of freed blocks, as it would with
+// malloc()
+#ifdef __SANITIZE_ADDRESS__
+#include <sanitizer/asan_interface.h>
+#else
+#define ASAN_POISON_MEMORY_REGION(addr, size) ((void)(addr), (void)(size))
+#define ASAN_UNPOISON_MEMORY_REGION(addr, size) ((void)(addr), (void)(size))
+#endif
+
+#define SLAB_GRANULE 16
+#define SLAB_CLASSES (SLAB_MAX_SIZE / SLAB_GRANULE)
+#define SLAB_PAGE_SIZE (64 * 1024)
+
+// at least this much in pages before compaction is worth it
+#define SLAB_COMPACT_MIN (4 * 1024 * 1024)
+
+#define SIZE_CLASS(size) (((size) - 1) / SLAB_GRANULE)
+#define CLASS_SIZE(class) (((class) + 1) * SLAB_GRANULE)
+
+typedef struct Block
+{
+    struct Block *next;
+} Block;
+
+// pages are aligned to their size, so a block finds its page by
+// masking its address
+typedef struct Page
+{
+    struct Page *next;
+    int sizeClass;
+    int live;      // live blocks, counted by compaction
+    bool evacuate; // emptied by compaction
+    uint8_t liveBits[SLAB_PAGE_SIZE / SLAB_GRANULE / 8];
+} Page;
+
+// blocks start after the page header, 16-byte aligned
+#define PAGE_HEADER_SIZE \
+    ((sizeof(Page) + SLAB_GRANULE - 1) / SLAB_GRANULE * SLAB_GRANULE)
+#define PAGE_BLOCKS(class) \
+    ((SLAB_PAGE_SIZE - PAGE_HEADER_SIZE) / CLASS_SIZE(class))
+#define PAGE_OF(pointer) \
+    ((Page *)((uintptr_t)(pointer) & ~(uintptr_t)(SLAB_PAGE_SIZE - 1)))
+
+typedef struct
+{
+    Block *free;     // freed blocks, reused first
+    char *bump;      // next never used block of the current page
+    char *end;       // end of the current page
+    Block *deferred; // freed by slabDefer(), back on free once reclaimed
+    Block *deferredTail;
+    int deferredCount;
+    size_t usedBlocks; // handed out and not freed
+    int pageCount;
+} SizeClass;
+
+static SizeClass classes[SLAB_CLASSES];
+static Page *pages = NULL;
+
+static void outOfPages()
+{
+    // exit if we have no more memory available
+    printf("REALLOCATION FAILED\n");
+    exit(1);
+}
+
+// maps a page aligned to its size, by mapping twice that and giving
+// back the slack on both ends
+static Page *mapPage()
+{
+    char *memory = mmap(NULL, SLAB_PAGE_SIZE * 2, PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (memory == MAP_FAILED)
+        outOfPages();
+
+    char *page = (char *)PAGE_OF(memory + SLAB_PAGE_SIZE - 1);
+    if (page > memory)
+        munmap(memory, page - memory);
+    munmap(page + SLAB_PAGE_SIZE, memory + SLAB_PAGE_SIZE - page);
+    return (Page *)page;
+}
+
+static void unmapPage(Page *page)
+{
+    ASAN_UNPOISON_MEMORY_REGION(page, SLAB_PAGE_SIZE);
+    munmap(page, SLAB_PAGE_SIZE);
+}
+
+// gives class a fresh page to carve blocks from
+static void newPage(int class)
+{
+    SizeClass *sizeClass = &classes[class];
+    Page *page = mapPage();
+    page->next = pages;
+    page->sizeClass = class;
+    page->live = 0;
+    page->evacuate = false;
+    pages = page;
+    sizeClass->pageCount++;
+
+    sizeClass->bump = (char *)page + PAGE_HEADER_SIZE;
+    sizeClass->end = (char *)page + SLAB_PAGE_SIZE;
+    ASAN_POISON_MEMORY_REGION(sizeClass->bump, sizeClass->end - sizeClass->bump);
+}
+
+// returns a block of at least size bytes, 0 < size <= SLAB_MAX_SIZE
+void *slabAllocate(size_t size)
+{
+    int class = SIZE_CLASS(size);
+    size_t blockSize = CLASS_SIZE(class);
+    SizeClass *sizeClass = &classes[class];
+    sizeClass->usedBlocks++;
+
+    Block *block = sizeClass->free;
+    if (block != NULL)
+    {
+        ASAN_UNPOISON_MEMORY_REGION(block, blockSize);
+        sizeClass->free = block->next;
+        return block;
+    }
+
+    if ((size_t)(sizeClass->end - sizeClass->bump) < blockSize)
+        newPage(class);
+    block = (Block *)sizeClass->bump;
+    sizeClass->bump += blockSize;
+    ASAN_UNPOISON_MEMORY_REGION(block, blockSize);
+    return block;
+}
+
+// puts a block from slabAllocate(size) back onto its free list
+void slabFree(void *pointer, size_t size)
+{
+    int class = SIZE_CLASS(size);
+    Block *block = pointer;
+    block->next = classes[class].free;
+    classes[class].free = block;
+    classes[class].usedBlocks--;
+    ASAN_POISON_MEMORY_REGION(block, CLASS_SIZE(class));
+}
+
+void slabDefer(void *pointer, size_t size)
+{
+    int class = SIZE_CLASS(size);
+    SizeClass *sizeClass = &classes[class];
+    Block *block = pointer;
+    block->next = sizeClass->deferred;
+    if (sizeClass->deferred == NULL)
+        sizeClass->deferredTail = block;
+    sizeClass->deferred = block;
+    sizeClass->deferredCount++;
+    ASAN_POISON_MEMORY_REGION(block, CLASS_SIZE(class));
+}
+
+void slabReclaim()
+{
+    for (int class = 0; class < SLAB_CLASSES; class++)
+    {
+        SizeClass *sizeClass = &classes[class];
+        if (sizeClass->deferred == NULL)
+            continue;
+
+        Block *tail = sizeClass->deferredTail;
+        ASAN_UNPOISON_MEMORY_REGION(tail, sizeof(Block));
+        tail->next = sizeClass->free;
+        ASAN_POISON_MEMORY_REGION(tail, CLASS_SIZE(class));
+        sizeClass->free = sizeClass->deferred;
+        sizeClass->usedBlocks -= sizeClass->deferredCount;
+        sizeClass->deferred = NULL;
+        sizeClass->deferredTail = NULL;
+        sizeClass->deferredCount = 0;
+    }
+}
+
+// ---------------- compaction -----------------
+
+// whether less than half of a sizeable amount of pages is in use
+bool slabFragmented()
+{
+    size_t pageBytes = 0, usedBytes = 0;
+    for (int class = 0; class < SLAB_CLASSES; class++)
+    {
+        pageBytes += (size_t)classes[class].pageCount * SLAB_PAGE_SIZE;
+        usedBytes += classes[class].usedBlocks * CLASS_SIZE(class);
+    }
+    return pageBytes >= SLAB_COMPACT_MIN && usedBytes < pageBytes / 2;
+}
+
+void slabBeginCompaction()
+{
+    for (Page *page = pages; page != NULL; page = page->next)
+    {
+        page->live = 0;
+        page->evacuate = false;
+        memset(page->liveBits, 0, sizeof(page->liveBits));
+    }
+}
+
+// records that the block at pointer holds a live object
+void slabMarkLive(void *pointer)
+{
+    Page *page = PAGE_OF(pointer);
+    int index = ((char *)pointer - (char *)page - PAGE_HEADER_SIZE) /
+                CLASS_SIZE(page->sizeClass);
+    page->liveBits[index / 8] |= 1 << (index % 8);
+    page->live++;
+}
+
+static int byLiveDescending(const void *a, const void *b)
+{
+    return (*(Page **)b)->live - (*(Page **)a)->live;
+}
+
+// puts every block of page not marked live onto the free list
+static void freeDeadBlocks(Page *page)
+{
+    SizeClass *sizeClass = &classes[page->sizeClass];
+    size_t blockSize = CLASS_SIZE(page->sizeClass);
+    char *first = (char *)page + PAGE_HEADER_SIZE;
+    for (int i = PAGE_BLOCKS(page->sizeClass) - 1; i >= 0; i--)
+    {
+        if (page->liveBits[i / 8] & (1 << (i % 8)))
+            continue;
+        Block *block = (Block *)(first + i * blockSize);
+        ASAN_UNPOISON_MEMORY_REGION(block, sizeof(Block));
+        block->next = sizeClass->free;
+        sizeClass->free = block;
+        ASAN_POISON_MEMORY_REGION(block, blockSize);
+    }
+}
+
+// after slabMarkLive() was called for every live block: keeps the
+// fullest pages of each class that can hold all its live blocks and
+// marks the others to be evacuated. the free lists are rebuilt from
+// the kept pages only, so the moved objects land there. returns
+// whether any page is to be evacuated
+bool slabPlanCompaction()
+{
+    bool evacuating = false;
+    for (int class = 0; class < SLAB_CLASSES; class++)
+    {
+        SizeClass *sizeClass = &classes[class];
+        if (sizeClass->pageCount == 0)
+            continue;
+
+        Page **classPages = malloc(sizeof(Page *) * sizeClass->pageCount);
+        if (classPages == NULL)
+            outOfPages();
+        int count = 0;
+        size_t live = 0;
+        for (Page *page = pages; page != NULL; page = page->next)
+        {
+            if (page->sizeClass == class)
+            {
+                classPages[count++] = page;
+                live += page->live;
+            }
+        }
+        qsort(classPages, count, sizeof(Page *), byLiveDescending);
+
+        int perPage = PAGE_BLOCKS(class);
+        int keep = (int)((live + perPage - 1) / perPage);
+        sizeClass->free = NULL;
+        sizeClass->bump = sizeClass->end = NULL;
+        for (int i = 0; i < count; i++)
+        {
+            if (i < keep)
+                freeDeadBlocks(classPages[i]);
+            else
+            {
+                classPages[i]->evacuate = true;
+                evacuating = true;
+            }
+        }
+        free(classPages);
+    }
+    return evacuating;
+}
+
+// whether the block at pointer has to move
+bool slabEvacuating(void *pointer)
+{
+    return PAGE_OF(pointer)->evacuate;
+}
+
+// unmaps the evacuated pages, whose objects have all been moved.
+// returns the bytes given back
+size_t slabEndCompaction()
+{
+    size_t released = 0;
+    Page **link = &pages;
+    while (*link != NULL)
+    {
+        Page *page = *link;
+        if (!page->evacuate)
+        {
+            link = &page->next;
+            continue;
+        }
+        *link = page->next;
+
+        SizeClass *sizeClass = &classes[page->sizeClass];
+        sizeClass->usedBlocks -= page->live;
+        sizeClass->pageCount--;
+        unmapPage(page);
+        released += SLAB_PAGE_SIZE;
+    }
+    return released;
+}
+
+// -----------------------------------------------
+
+// gives every page back to the OS, all blocks must be free
+void freeSlabs()
+{
+    while (pages != NULL)
+    {
+        Page *next = pages->next;
+        unmapPage(pages);
+        pages = next;
+    }
+    memset(classes, 0, sizeof(classes));
+}
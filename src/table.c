@@ -7,138 +7,334 @@
 #include <stdio.h>
 #include <string.h>
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 #include "table.h"
+#include "hash.h"
 #include "mem.h"
 #include "object.h"
 #include "value.h"
 
-#define TABLE_MAX_LOAD 0.75
+// counts tombstones too, since they lengthen probes just the same
+#define TABLE_MAX_LOAD 0.875
+
+// tableCompact() shrinks below this load, and rehashes in place once
+// this share of the slots are tombstones
+#define TABLE_MIN_LOAD (TABLE_MAX_LOAD / 4)
+#define TABLE_MAX_TOMBSTONES 0.25
+
+// slots probed together
+#define GROUP_SIZE 16
+
+#define CTRL_EMPTY ((int8_t)-128)
+#define CTRL_DELETED ((int8_t)-2)
+
+// the low 7 bits of the hash go into the control byte of a full slot,
+// the others pick the group where probing starts
+#define HASH_GROUP(hash) ((hash) >> 7)
+#define HASH_CTRL(hash) ((int8_t)((hash) & 0x7F))
+
+// tables up to this many slots keep their entries packed at the front
+// and are scanned linearly, with no control bytes
+#define TABLE_LINEAR_MAX 8
+
+#define IS_LINEAR(capacity) ((capacity) <= TABLE_LINEAR_MAX)
+
+// bytes per slot: key, value and (when hashed) control byte
+#define SLOT_SIZE(capacity) \
+    (sizeof(ObjString *) + sizeof(Value) + (IS_LINEAR(capacity) ? 0 : sizeof(int8_t)))
+
+// bitmask of the slots in a group whose control byte equals byte
+static inline uint32_t matchByte(const int8_t *group, int8_t byte)
+{
+#ifdef __SSE2__
+    __m128i ctrl = _mm_loadu_si128((const __m128i *)group);
+    return _mm_movemask_epi8(_mm_cmpeq_epi8(ctrl, _mm_set1_epi8(byte)));
+#else
+    uint32_t mask = 0;
+    for (int i = 0; i < GROUP_SIZE; i++)
+        if (group[i] == byte)
+            mask |= 1u << i;
+    return mask;
+#endif
+}
+
+// bitmask of the empty or deleted slots in a group (the negative bytes)
+static inline uint32_t matchFree(const int8_t *group)
+{
+#ifdef __SSE2__
+    return _mm_movemask_epi8(_mm_loadu_si128((const __m128i *)group));
+#else
+    uint32_t mask = 0;
+    for (int i = 0; i < GROUP_SIZE; i++)
+        if (group[i] < 0)
+            mask |= 1u << i;
+    return mask;
+#endif
+}
 
 void initTable(Table *table)
 {
     table->count = 0;
+    table->tombstones = 0;
     table->capacity = 0;
-    table->entries = NULL;
+    table->ctrl = NULL;
+    table->keys = NULL;
+    table->values = NULL;
 }
 
 void freeTable(Table *table)
 {
-    FREE_ARRAY(Entry, table->entries, table->capacity);
+    FREE_ARRAY(char, table->keys, table->capacity * SLOT_SIZE(table->capacity));
     initTable(table);
 }
 
-static Entry *findEntry(Entry *entries, int capacity, ObjString *key)
+// whether slot i holds an entry
+static inline bool isLive(Table *table, int i)
+{
+    return IS_LINEAR(table->capacity) ? i < table->count : table->ctrl[i] >= 0;
+}
+
+static int findLinear(Table *table, ObjString *key)
 {
-    // bad for peformance: uint32_t index = key->hash % capacity;
-    uint32_t index = key->hash & (capacity - 1);
+    for (int i = 0; i < table->count; i++)
+    {
+        if (table->keys[i] == key)
+            return i;
+    }
+    return -1;
+}
 
-    Entry *tombstone = NULL;
+// returns the slot holding key, or -1. groups are visited in
+// triangular order (+1, +2, +3, ...), which covers every group since
+// their number is a power of two. a group with an empty slot ends the
+// search, as an insert would have stopped there
+static int findSlot(Table *table, ObjString *key)
+{
+    uint32_t groupMask = (uint32_t)table->capacity / GROUP_SIZE - 1;
+    uint32_t group = HASH_GROUP(key->hash) & groupMask;
+    int8_t ctrl = HASH_CTRL(key->hash);
 
-    for (;;)
+    for (uint32_t step = 1;; step++)
     {
-        Entry *entry = &entries[index];
-        // printf("'%s' vs '%s' ? %s\n", 
-        //     key->chars, entry->key != NULL ? entry->key->chars : "NULL",
-        //     key->chars == (entry->key != NULL ? entry->key->chars : "") ? "match" : "no match");
+        int8_t *groupCtrl = &table->ctrl[group * GROUP_SIZE];
 
-        if (entry->key == NULL)
+        for (uint32_t match = matchByte(groupCtrl, ctrl); match != 0; match &= match - 1)
         {
-            if (IS_NULL(entry->value))
-            {
-                // Empty entry.
-                return tombstone != NULL ? tombstone : entry;
-            }
-            else
-            {
-                // We found a tombstone.
-                if (tombstone == NULL)
-                    tombstone = entry;
-            }
-        }
-        else if (entry->key == key)
-        {
-            // We found the key.
-            return entry;
+            int index = group * GROUP_SIZE + __builtin_ctz(match);
+            if (table->keys[index] == key)
+                return index;
         }
 
-        // bad for performance: index = (index + 1) % capacity;
-        index = (index + 1) & (capacity - 1);
+        if (matchByte(groupCtrl, CTRL_EMPTY) != 0)
+            return -1;
+
+        group = (group + step) & groupMask;
     }
 }
 
-static void adjustCapacity(Table *table, int capacity)
+// returns the first empty or deleted slot on the probe path of hash
+static int findFreeSlot(int8_t *ctrl, int capacity, uint32_t hash)
 {
-    Entry *entries = ALLOCATE(Entry, capacity);
+    uint32_t groupMask = (uint32_t)capacity / GROUP_SIZE - 1;
+    uint32_t group = HASH_GROUP(hash) & groupMask;
+
+    for (uint32_t step = 1;; step++)
+    {
+        uint32_t match = matchFree(&ctrl[group * GROUP_SIZE]);
+        if (match != 0)
+            return group * GROUP_SIZE + __builtin_ctz(match);
 
-    for (int i = 0; i < capacity; i++)
+        group = (group + step) & groupMask;
+    }
+}
+
+// moves all live entries into new arrays of the given capacity,
+// which also drops all tombstones
+static void adjustCapacity(Table *table, int capacity)
+{
+    ObjString **keys = (ObjString **)ALLOCATE(char, capacity * SLOT_SIZE(capacity));
+    Value *values = (Value *)(keys + capacity);
+    int8_t *ctrl = NULL;
+    if (!IS_LINEAR(capacity))
     {
-        entries[i].key = NULL;
-        entries[i].value = NULL_VAL;
+        ctrl = (int8_t *)(values + capacity);
+        memset(ctrl, CTRL_EMPTY, capacity);
     }
 
-    table->count = 0;
+    int count = 0;
     for (int i = 0; i < table->capacity; i++)
     {
-        Entry *entry = &table->entries[i];
-        if (entry->key == NULL)
+        if (!isLive(table, i))
             continue;
 
-        Entry *dest = findEntry(entries, capacity, entry->key);
-        dest->key = entry->key;
-        dest->value = entry->value;
-        table->count++;
+        ObjString *key = table->keys[i];
+        int index = count++;
+        if (ctrl != NULL)
+        {
+            index = findFreeSlot(ctrl, capacity, key->hash);
+            ctrl[index] = HASH_CTRL(key->hash);
+        }
+        keys[index] = key;
+        values[index] = table->values[i];
     }
 
-    FREE_ARRAY(Entry, table->entries, table->capacity);
+    FREE_ARRAY(char, table->keys, table->capacity * SLOT_SIZE(table->capacity));
 
-    table->entries = entries;
+    table->tombstones = 0;
     table->capacity = capacity;
+    table->ctrl = ctrl;
+    table->keys = keys;
+    table->values = values;
 }
 
+// tables are keyed by interned strings only, so an uninterned key
+// has to be swapped for its interned twin before probing
 bool tableGet(Table *table, ObjString *key, Value *value)
 {
-    if (table->entries == NULL)
+    if (table->count == 0)
+        return false;
+    if ((key = findInternedString(key)) == NULL)
         return false;
 
-    Entry *entry = findEntry(table->entries, table->capacity, key);
-    if (entry->key == NULL)
+    int index = IS_LINEAR(table->capacity) ? findLinear(table, key) : findSlot(table, key);
+    if (index == -1)
         return false;
 
-    *value = entry->value;
+    *value = table->values[index];
     return true;
 }
 
 bool tableSet(Table *table, ObjString *key, Value value)
 {
-    if (table->count + 1 > table->capacity * TABLE_MAX_LOAD)
+    key = internString(key);
+
+    bool linear = IS_LINEAR(table->capacity);
+    if (table->count != 0)
     {
-        int capacity = GROW_CAPACITY(table->capacity);
-        adjustCapacity(table, capacity);
+        int index = linear ? findLinear(table, key) : findSlot(table, key);
+        if (index != -1)
+        {
+            table->values[index] = value;
+            return false;
+        }
     }
 
-    Entry *entry = findEntry(table->entries, table->capacity, key);
+    if (linear)
+    {
+        // grows 2, 4, 8, then turns into a hashed table of one group
+        if (table->count == table->capacity)
+        {
+            adjustCapacity(table, table->capacity == 0 ? 2 : table->capacity * 2);
+            linear = IS_LINEAR(table->capacity);
+        }
+        if (linear)
+        {
+            table->keys[table->count] = key;
+            table->values[table->count] = value;
+            table->count++;
+            return true;
+        }
+    }
+    else if (table->count + table->tombstones + 1 > table->capacity * TABLE_MAX_LOAD)
+    {
+        // mostly tombstones: rehashing in place is enough
+        int capacity = table->capacity;
+        if (table->count + 1 > capacity * TABLE_MAX_LOAD / 2)
+            capacity *= 2;
+        adjustCapacity(table, capacity);
+    }
 
-    bool isNewKey = entry->key == NULL;
-    if (isNewKey && IS_NULL(entry->value))
-        table->count++;
+    int index = findFreeSlot(table->ctrl, table->capacity, key->hash);
+    if (table->ctrl[index] == CTRL_DELETED)
+        table->tombstones--;
 
-    entry->key = key;
-    entry->value = value;
-    return isNewKey;
+    table->ctrl[index] = HASH_CTRL(key->hash);
+    table->keys[index] = key;
+    table->values[index] = value;
+    table->count++;
+    return true;
 }
 
+// never allocates, so the collector can delete while it runs.
+// shrinking is left to tableCompact()
 bool tableDelete(Table *table, ObjString *key)
 {
     if (table->count == 0)
         return false;
+    if ((key = findInternedString(key)) == NULL)
+        return false;
+
+    if (IS_LINEAR(table->capacity))
+    {
+        int index = findLinear(table, key);
+        if (index == -1)
+            return false;
+
+        // the last entry fills the hole to keep them packed
+        table->count--;
+        table->keys[index] = table->keys[table->count];
+        table->values[index] = table->values[table->count];
+        table->keys[table->count] = NULL;
+        table->values[table->count] = NULL_VAL;
+        return true;
+    }
 
-    Entry *entry = findEntry(table->entries, table->capacity, key);
-    if (entry->key == NULL)
+    int index = findSlot(table, key);
+    if (index == -1)
         return false;
 
-    entry->key = NULL;
-    entry->value = BOOL_VAL(true);
+    // a group that still has an empty slot never made a probe move on,
+    // so the slot can become empty again instead of a tombstone
+    int8_t *groupCtrl = &table->ctrl[index - index % GROUP_SIZE];
+    if (matchByte(groupCtrl, CTRL_EMPTY) != 0)
+        table->ctrl[index] = CTRL_EMPTY;
+    else
+    {
+        table->ctrl[index] = CTRL_DELETED;
+        table->tombstones++;
+    }
+
+    table->keys[index] = NULL;
+    table->values[index] = NULL_VAL;
+    table->count--;
+    return true;
+}
+
+// smallest capacity that holds count entries at half the max load
+static int fitCapacity(int count)
+{
+    if (count == 0)
+        return 0;
+
+    int capacity = 2;
+    while (capacity < count && capacity < TABLE_LINEAR_MAX)
+        capacity *= 2;
+    if (count <= capacity)
+        return capacity;
+
+    capacity = GROUP_SIZE;
+    while (count > capacity * TABLE_MAX_LOAD / 2)
+        capacity *= 2;
+    return capacity;
+}
+
+// shrinks a table that lost most of its entries and rehashes one
+// that filled up with tombstones. returns whether it did either
+bool tableCompact(Table *table)
+{
+    int capacity = table->capacity;
+    if (table->count < capacity * TABLE_MIN_LOAD)
+        capacity = fitCapacity(table->count);
+    else if (table->tombstones <= capacity * TABLE_MAX_TOMBSTONES)
+        return false;
 
+    if (capacity == 0)
+        freeTable(table);
+    else
+        adjustCapacity(table, capacity);
     return true;
 }
 
@@ -146,64 +342,309 @@ void tableAddAll(Table *from, Table *to)
 {
     for (int i = 0; i < from->capacity; i++)
     {
-        Entry *entry = &from->entries[i];
-
-        if (entry->key != NULL)
-        {
-            // printf("\nKEY: %s, HASH: %d, VALUE: %s",
-            //     entry->key->chars, entry->key->hash, valueToString(entry->value));
-            tableSet(to, entry->key, entry->value);
-        }
+        if (isLive(from, i))
+            tableSet(to, from->keys[i], from->values[i]);
     }
 }
 
 ObjString *tableFindString(Table *table, const char *chars, int length,
                            uint32_t hash)
 {
-    if (table->entries == NULL)
+    if (table->count == 0)
+        return NULL;
+
+    if (IS_LINEAR(table->capacity))
+    {
+        for (int i = 0; i < table->count; i++)
+        {
+            ObjString *key = table->keys[i];
+            if (key->length == length && key->hash == hash &&
+                memcmp(key->chars, chars, length) == 0)
+                return key;
+        }
         return NULL;
+    }
 
-    // bad for performace: uint32_t index = hash % table->capacity;
-    uint32_t index = hash & (table->capacity - 1);
+    uint32_t groupMask = (uint32_t)table->capacity / GROUP_SIZE - 1;
+    uint32_t group = HASH_GROUP(hash) & groupMask;
+    int8_t ctrl = HASH_CTRL(hash);
 
-    for (;;)
+    for (uint32_t step = 1;; step++)
     {
-        Entry *entry = &table->entries[index];
+        int8_t *groupCtrl = &table->ctrl[group * GROUP_SIZE];
 
-        if (entry->key == NULL)
+        for (uint32_t match = matchByte(groupCtrl, ctrl); match != 0; match &= match - 1)
         {
-            if (IS_NULL(entry->value))
-                return NULL;
+            ObjString *key = table->keys[group * GROUP_SIZE + __builtin_ctz(match)];
+            if (key->length == length && key->hash == hash &&
+                memcmp(key->chars, chars, length) == 0)
+                return key;
         }
-        else if (entry->key->length == length && entry->key->hash == hash && memcmp(entry->key->chars, chars, length) == 0)
+
+        if (matchByte(groupCtrl, CTRL_EMPTY) != 0)
+            return NULL;
+
+        group = (group + step) & groupMask;
+    }
+}
+
+// removes slots that are not referenced by marked objects. walks
+// backwards, since a linear delete moves the last entry into the hole
+void tableRemoveWhite(Table *table)
+{
+    for (int i = table->capacity - 1; i >= 0; i--)
+    {
+        if (isLive(table, i) && !IS_MARKED(&table->keys[i]->obj))
+            tableDelete(table, table->keys[i]);
+    }
+}
+
+void markTable(Table *table)
+{
+    for (int i = 0; i < table->capacity; i++)
+    {
+        if (!isLive(table, i))
+            continue;
+        markObject((Obj *)table->keys[i]);
+        markValue(table->values[i]);
+    }
+}
+
+// keys are found by their string hash, so they can move in place
+void forwardTable(Table *table)
+{
+    for (int i = 0; i < table->capacity; i++)
+    {
+        if (!isLive(table, i))
+            continue;
+        table->keys[i] = (ObjString *)forwardObject((Obj *)table->keys[i]);
+        forwardValue(&table->values[i]);
+    }
+}
+
+// ------------------- ValueTable ---------------------
+// same layout and probing as a hashed Table, but keys are compared
+// with valuesEqual(), so equal keys must hash alike
+
+// bytes per slot: key, value and control byte
+#define VALUE_SLOT_SIZE (2 * sizeof(Value) + sizeof(int8_t))
+
+static inline uint32_t hashBits(uint64_t bits)
+{
+    return (uint32_t)hashMix(bits ^ hashSecret[0], hashSecret[1]);
+}
+
+// numbers, bools and strings hash by value, other objects by identity
+uint32_t hashValue(Value value)
+{
+    switch (value.type)
+    {
+    case VAL_BOOL:
+        return hashBits(AS_BOOL(value) ? 1 : 2);
+    case VAL_NULL:
+        return hashBits(0);
+    case VAL_NUMBER:
+    {
+        // 0 == -0, so both have to give the same bits
+        double number = AS_NUMBER(value) == 0 ? 0 : AS_NUMBER(value);
+        uint64_t bits;
+        memcpy(&bits, &number, sizeof(bits));
+        return hashBits(bits);
+    }
+    case VAL_OBJ:
+        if (IS_STRING(value))
+            return stringHash(AS_STRING(value));
+        return hashBits((uint64_t)(uintptr_t)AS_OBJ(value));
+    }
+    return 0;
+}
+
+void initValueTable(ValueTable *table)
+{
+    table->count = 0;
+    table->tombstones = 0;
+    table->capacity = 0;
+    table->ctrl = NULL;
+    table->keys = NULL;
+    table->values = NULL;
+}
+
+void freeValueTable(ValueTable *table)
+{
+    FREE_ARRAY(char, table->keys, table->capacity * VALUE_SLOT_SIZE);
+    initValueTable(table);
+}
+
+static int findValueSlot(ValueTable *table, Value key, uint32_t hash)
+{
+    uint32_t groupMask = (uint32_t)table->capacity / GROUP_SIZE - 1;
+    uint32_t group = HASH_GROUP(hash) & groupMask;
+    int8_t ctrl = HASH_CTRL(hash);
+
+    for (uint32_t step = 1;; step++)
+    {
+        int8_t *groupCtrl = &table->ctrl[group * GROUP_SIZE];
+
+        for (uint32_t match = matchByte(groupCtrl, ctrl); match != 0; match &= match - 1)
         {
-            return entry->key;
+            int index = group * GROUP_SIZE + __builtin_ctz(match);
+            if (valuesEqual(table->keys[index], key))
+                return index;
         }
 
-        // bad for performance: index = (index + 1) % table->capacity;
-        index = (index + 1) & (table->capacity - 1);
+        if (matchByte(groupCtrl, CTRL_EMPTY) != 0)
+            return -1;
+
+        group = (group + step) & groupMask;
     }
 }
 
-// removes slots that are not referenced by marked objects
-void tableRemoveWhite(Table *table)
+static void adjustValueCapacity(ValueTable *table, int capacity)
 {
+    Value *keys = (Value *)ALLOCATE(char, capacity * VALUE_SLOT_SIZE);
+    Value *values = keys + capacity;
+    int8_t *ctrl = (int8_t *)(values + capacity);
+    memset(ctrl, CTRL_EMPTY, capacity);
+
     for (int i = 0; i < table->capacity; i++)
     {
-        Entry *entry = &table->entries[i];
-        if (entry->key != NULL && !entry->key->obj.isMarked)
+        if (table->ctrl[i] < 0)
+            continue;
+
+        uint32_t hash = hashValue(table->keys[i]);
+        int index = findFreeSlot(ctrl, capacity, hash);
+        ctrl[index] = HASH_CTRL(hash);
+        keys[index] = table->keys[i];
+        values[index] = table->values[i];
+    }
+
+    FREE_ARRAY(char, table->keys, table->capacity * VALUE_SLOT_SIZE);
+
+    table->tombstones = 0;
+    table->capacity = capacity;
+    table->ctrl = ctrl;
+    table->keys = keys;
+    table->values = values;
+}
+
+bool valueTableGet(ValueTable *table, Value key, Value *value)
+{
+    if (table->count == 0)
+        return false;
+
+    int index = findValueSlot(table, key, hashValue(key));
+    if (index == -1)
+        return false;
+
+    *value = table->values[index];
+    return true;
+}
+
+bool valueTableSet(ValueTable *table, Value key, Value value)
+{
+    uint32_t hash = hashValue(key);
+
+    if (table->count != 0)
+    {
+        int index = findValueSlot(table, key, hash);
+        if (index != -1)
         {
-            tableDelete(table, entry->key);
+            table->values[index] = value;
+            return false;
         }
     }
+
+    if (table->count + table->tombstones + 1 > table->capacity * TABLE_MAX_LOAD)
+    {
+        int capacity = table->capacity;
+        if (table->count + 1 > capacity * TABLE_MAX_LOAD / 2)
+            capacity = capacity < GROUP_SIZE ? GROUP_SIZE : capacity * 2;
+        adjustValueCapacity(table, capacity);
+    }
+
+    int index = findFreeSlot(table->ctrl, table->capacity, hash);
+    if (table->ctrl[index] == CTRL_DELETED)
+        table->tombstones--;
+
+    table->ctrl[index] = HASH_CTRL(hash);
+    table->keys[index] = key;
+    table->values[index] = value;
+    table->count++;
+    return true;
 }
 
-void markTable(Table *table)
+// unlike tableDelete() this compacts right away, as the collector
+// never deletes from value tables
+bool valueTableDelete(ValueTable *table, Value key)
+{
+    if (table->count == 0)
+        return false;
+
+    int index = findValueSlot(table, key, hashValue(key));
+    if (index == -1)
+        return false;
+
+    int8_t *groupCtrl = &table->ctrl[index - index % GROUP_SIZE];
+    if (matchByte(groupCtrl, CTRL_EMPTY) != 0)
+        table->ctrl[index] = CTRL_EMPTY;
+    else
+    {
+        table->ctrl[index] = CTRL_DELETED;
+        table->tombstones++;
+    }
+
+    table->keys[index] = NULL_VAL;
+    table->values[index] = NULL_VAL;
+    table->count--;
+
+    if (table->count == 0)
+        freeValueTable(table);
+    else if (table->capacity > GROUP_SIZE && table->count < table->capacity * TABLE_MIN_LOAD)
+    {
+        int capacity = GROUP_SIZE;
+        while (table->count > capacity * TABLE_MAX_LOAD / 2)
+            capacity *= 2;
+        adjustValueCapacity(table, capacity);
+    }
+    else if (table->tombstones > table->capacity * TABLE_MAX_TOMBSTONES)
+        adjustValueCapacity(table, table->capacity);
+    return true;
+}
+
+// reads slot index, returning false if it is empty. callers walk
+// the slots from 0 to capacity
+bool valueTableEntry(ValueTable *table, int index, Value *key, Value *value)
+{
+    if (table->ctrl[index] < 0)
+        return false;
+
+    *key = table->keys[index];
+    *value = table->values[index];
+    return true;
+}
+
+void markValueTable(ValueTable *table)
+{
+    for (int i = 0; i < table->capacity; i++)
+    {
+        if (table->ctrl[i] < 0)
+            continue;
+        markValue(table->keys[i]);
+        markValue(table->values[i]);
+    }
+}
+
+// objects hash by address, so moved keys need a rehash
+void forwardValueTable(ValueTable *table)
 {
+    if (table->count == 0)
+        return;
     for (int i = 0; i < table->capacity; i++)
     {
-        Entry *entry = &table->entries[i];
-        markObject((Obj *)entry->key);
-        markValue(entry->value);
+        if (table->ctrl[i] < 0)
+            continue;
+        forwardValue(&table->keys[i]);
+        forwardValue(&table->values[i]);
     }
-}
\ No newline at end of file
+    adjustValueCapacity(table, table->capacity);
+}
@@ -3,6 +3,7 @@
 #include <string.h>
 
 #include "mem.h"
+#include "number.h"
 #include "value.h"
 #include "object.h"
 
@@ -45,7 +46,12 @@ char *valueToString(Value value)
     {
     case VAL_NULL:   return "null";
     case VAL_BOOL:   return AS_BOOL(value) ? "true" : "false";
-    case VAL_NUMBER: return formatString("%g", AS_NUMBER(value));
+    case VAL_NUMBER:
+    {
+        char buffer[NUMBER_BUFFER_SIZE];
+        formatNumber(AS_NUMBER(value), buffer);
+        return formatString("%s", buffer);
+    }
     case VAL_OBJ:    return objectToString(value);
     }
     return "<VALUE-TO-STRING-ERROR>";
@@ -53,6 +59,13 @@ char *valueToString(Value value)
 
 void printValue(Value value)
 {
+    if (IS_NUMBER(value))
+    {
+        char buffer[NUMBER_BUFFER_SIZE];
+        formatNumber(AS_NUMBER(value), buffer);
+        fputs(buffer, stdout);
+        return;
+    }
     printf("%s", valueToString(value));
 }
 
@@ -70,6 +83,8 @@ bool valuesEqual(Value a, Value b)
         return AS_NUMBER(a) == AS_NUMBER(b);
     case VAL_OBJ:
     {
+        if (IS_STRING(a) && IS_STRING(b))
+            return stringsEqual(AS_STRING(a), AS_STRING(b));
         return AS_OBJ(a) == AS_OBJ(b);
     }
     default:
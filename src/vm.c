@@ -15,8 +15,10 @@
 #include "scanner.h"
 #include "object.h"
 #include "mem.h"
+#include "memo.h"
 #include "natives.h"
 #include "methods.h"
+#include "number.h"
 #include "vm.h"
 
 VM vm;
@@ -70,8 +72,11 @@ static void defineNativeVars()
 {
 	int count = sizeof NativeVars / sizeof NativeVars[0];
 	for (int i = 0; i < count; i++)
-		tableSet(&vm.nativeVars, 
-			copyString(NativeVars[i], strlen(NativeVars[i])), NULL_VAL);
+	{
+		push(OBJ_VAL(copyString(NativeVars[i], strlen(NativeVars[i]))));
+		tableSet(&vm.nativeVars, AS_STRING(vm.stackTop[-1]), NULL_VAL);
+		pop();
+	}
 }
 
 // initialize the VM
@@ -79,15 +84,42 @@ void initVM(bool import_mode)
 {
 	resetStack();
 	vm.bytesAllocated = 0;
-	vm.nextGC = 1024 * 1024;
+	vm.youngBytes = 0;
+	vm.collecting = false;
 	vm.objects = NULL;
+	vm.youngObjects = NULL;
 	vm.grayCount = 0;
 	vm.grayCapacity = 0;
 	vm.grayStack = NULL;
+	vm.rememberedCount = 0;
+	vm.rememberedCapacity = 0;
+	vm.remembered = NULL;
+	vm.markBit = true;
+	vm.gcPhase = GC_IDLE;
+	vm.stepBytes = 0;
+	vm.stepWork = GC_STEP_WORK;
+	vm.scanArray = NULL;
+	vm.scanIndex = 0;
+	vm.gcThreads = defaultGcThreads();
+	vm.gcStats = (GcStats){0};
+	vm.heapPolicy = (HeapPolicy){
+		.initialHeap = 1024 * 1024,
+		.growFactor = 2,
+		.minInterval = 0,
+		.maxInterval = 0,
+		.maxHeap = 0,
+		.compact = false,
+	};
+	vm.nextGC = vm.heapPolicy.initialHeap;
+	vm.heapJump = NULL;
+	vm.compactPending = false;
+	vm.scratch = NULL;
+	vm.scratchSpare = NULL;
 	initTable(&vm.nativeVars);
 	initTable(&vm.strings);
 	initTable(&vm.globals);
 	initTable(&vm.globalsTypes);
+	initShortStrings();
 
 	vm.initString = NULL;
 	vm.initString = copyString("Init", 4);
@@ -105,6 +137,7 @@ void freeVM()
 {
 	vm.initString = NULL;
 	freeObjects();
+	freeScratch();
 	freeTable(&vm.nativeVars);
 	freeTable(&vm.strings);
 	freeTable(&vm.globals);
@@ -166,6 +199,32 @@ static bool call(ObjClosure *closure, int argCount)
 	frame->closure = closure;
 	frame->ip = closure->function->chunk.code;
 	frame->slots = vm.stackTop - argCount - 1;
+	frame->memoEntry = -1;
+	return true;
+}
+
+// calls the native method with its receiver in the callee slot,
+// see methods.h
+static bool callNativeMethod(ObjNative *native, int argCount)
+{
+	push(vm.stackTop[-argCount - 1]);
+	argCount++;
+
+	// arity -1 indicates that the arity is handled by the native
+	if (native->arity != -1 && argCount != native->arity)
+	{
+		runtimeError("Expected %d arguments but got %d.", native->arity, argCount);
+		return false;
+	}
+
+	Value result = native->function(argCount, vm.stackTop - argCount);
+	scratchClear();
+	// -1 as result type marks runtimeError inside native
+	if (result.type == -1)
+		return false;
+
+	vm.stackTop -= argCount + 1;
+	push(result);
 	return true;
 }
 
@@ -193,6 +252,7 @@ bool callValue(Value callee, int argCount)
 			
 			tableAddAll(&klass->fields, &instance->fields);
 			tableAddAll(&klass->fieldsTypes, &instance->fieldsTypes);
+			writeBarrier((Obj *)instance);
 
 			Value initializer;
 			if (tableGet(&klass->methods, vm.initString, &initializer))
@@ -210,6 +270,27 @@ bool callValue(Value callee, int argCount)
 		}
 		case OBJ_CLOSURE:
 			return call(AS_CLOSURE(callee), argCount);
+		case OBJ_MEMO:
+		{
+			ObjMemo *memo = AS_MEMO(callee);
+			Value result;
+			int entry = -1;
+			// a wrong argument count is reported by call()
+			if (argCount == memo->arity &&
+				memoLookup(memo, vm.stackTop - argCount, &result, &entry))
+			{
+				vm.stackTop -= argCount + 1;
+				push(result);
+				return true;
+			}
+
+			if (!call(memo->closure, argCount))
+				return false;
+			CallFrame *frame = &vm.frames[vm.frameCount - 1];
+			frame->memoEntry = entry;
+			frame->memoStamp = entry != -1 ? memo->entries[entry].stamp : 0;
+			return true;
+		}
 		case OBJ_NATIVE:
 		{
 			// NativeFn native = AS_NATIVE(callee);
@@ -223,6 +304,7 @@ bool callValue(Value callee, int argCount)
 			}
 
 			Value result = native->function(argCount, vm.stackTop - argCount);
+			scratchClear(); // whatever text the native formatted
 			// -1 as result type marks runtimeError inside native
 			if (result.type == -1)
 				return false;
@@ -234,24 +316,9 @@ bool callValue(Value callee, int argCount)
 		case OBJ_BOUND_N_M:
 		{
 			ObjBoundNativeMethod *method = AS_BOUND_N_M(callee);
-			push(method->receiver);
-			argCount++;
-
-			// arity -1 indicates that the arity is handled by the native
-			if (method->native->arity != -1 && argCount != method->native->arity)
-			{
-				runtimeError("Expected %d arguments but got %d.", method->native->arity, argCount);
-				return false;
-			}
-
-			Value result = method->native->function(argCount, vm.stackTop - argCount);
-			// -1 as result type marks runtimeError inside native
-			if (result.type == -1)
-				return false;
-
-			vm.stackTop -= argCount + 1;
-			push(result);
-			return true;
+			// natives find their receiver in the callee slot
+			vm.stackTop[-argCount - 1] = method->receiver;
+			return callNativeMethod(method->native, argCount);
 		}
 		case OBJ_DATA_TYPE:
 		{
@@ -284,9 +351,9 @@ static bool invokeFromClass(ObjClass *klass, ObjString *name, int argCount)
 	return call(AS_CLOSURE(method), argCount);
 }
 
-static bool bindNativeMethod(Value value, ObjString *name)
+// looks up the native method name of value, NULL if there is none
+static ObjNative *findNativeMethod(Value value, ObjString *name)
 {
-	// ObjBoundNativeMethod *method = newBoundNativeMethod();
 	ValueArray *methods;
 	bool arrayNotFound = false;
 
@@ -299,39 +366,37 @@ static bool bindNativeMethod(Value value, ObjString *name)
 		{
 		case OBJ_STRING: methods = &stringMethods; break;
 		case OBJ_ARRAY:  methods = &arrayMethods; break;
+		case OBJ_STRING_BUILDER: methods = &stringBuilderMethods; break;
+		case OBJ_MAP:    methods = &mapMethods; break;
 		default: arrayNotFound = true; break;
 		}
 		break;
 	default: arrayNotFound = true; break;
 	}
 
-	if (arrayNotFound)
-	{
-		runtimeError("Undefined property '%s'.", name->chars);
-		return false;
-	}
-
-	// get method from array
-	ObjNative *native;
-	bool methodNotFound = true;
-	for (int i = 0; i < methods->count; i++)
+	if (!arrayNotFound)
 	{
-		if (valuesEqual(OBJ_VAL(AS_NATIVE(methods->values[i])->name), OBJ_VAL(name)))
+		// get method from array
+		for (int i = 0; i < methods->count; i++)
 		{
-			native = AS_NATIVE(methods->values[i]);
-			methodNotFound = false;
-			break;
+			if (valuesEqual(OBJ_VAL(AS_NATIVE(methods->values[i])->name), OBJ_VAL(name)))
+				return AS_NATIVE(methods->values[i]);
 		}
 	}
-	
-	ObjBoundNativeMethod *method = newBoundNativeMethod(value, native);
 
-	if (methodNotFound)
-	{
-		runtimeError("Undefined property '%s'.", name->chars);
+	runtimeError("Undefined property '%s'.", name->chars);
+	return NULL;
+}
+
+// replaces the value on top of the stack with its native method name
+static bool bindNativeMethod(ObjString *name)
+{
+	ObjNative *native = findNativeMethod(peek(0), name);
+	if (native == NULL)
 		return false;
-	}
 
+	ObjBoundNativeMethod *method = newBoundNativeMethod(peek(0), native);
+	pop();
 	push(OBJ_VAL(method));
 	return true;
 }
@@ -362,9 +427,11 @@ static bool invoke(ObjString *name, int argCount)
 	}
 	else
 	{
-		if (!bindNativeMethod(receiver, name))
+		// called right away, so there is no need to bind it
+		ObjNative *native = findNativeMethod(receiver, name);
+		if (native == NULL)
 			return false;
-		return callValue(pop(), argCount);
+		return callNativeMethod(native, argCount);
 	}
 }
 
@@ -425,6 +492,7 @@ static void closeUpvalues(Value *last)
 		ObjUpvalue *upvalue = vm.openUpvalues;
 		upvalue->closed = *upvalue->location;
 		upvalue->location = &upvalue->closed;
+		writeBarrier((Obj *)upvalue);
 		vm.openUpvalues = upvalue->next;
 	}
 }
@@ -436,6 +504,7 @@ static void defineMethod(ObjString *name)
 	Value method = peek(0);
 	ObjClass *klass = AS_CLASS(peek(1));
 	tableSet(&klass->methods, name, method);
+	writeBarrier((Obj *)klass);
 	pop();
 }
 
@@ -474,13 +543,21 @@ bool isFalsey(Value value)
 	return true;
 }
 
+// closures, natives and memoized functions are all of type Fun
+static bool isFunType(ObjType type)
+{
+	return type == OBJ_CLOSURE || type == OBJ_FUNCTION ||
+		type == OBJ_NATIVE || type == OBJ_MEMO;
+}
+
 // check if datatype is correct (example format: "Expect type %s, not %s.")
 static bool checkType(Value value, ObjDataType type, const char* format)
 {
 	if (type.isAny) return true;
 
 	if (value.type != type.valueType ||
-		(IS_OBJ(value) && OBJ_TYPE(value) != type.objType))
+		(IS_OBJ(value) && OBJ_TYPE(value) != type.objType &&
+		 !(isFunType(OBJ_TYPE(value)) && isFunType(type.objType))))
 	{
 		runtimeError(format,
 			objectToString(OBJ_VAL(&type)),
@@ -496,19 +573,80 @@ static void concatenate()
 	ObjString *b = AS_STRING(peek(0));
 	ObjString *a = AS_STRING(peek(1));
 
-	int length = a->length + b->length;
-	char *chars = ALLOCATE(char, length + 1);
-	memcpy(chars, a->chars, a->length);
-	memcpy(chars + a->length, b->chars, b->length);
-	chars[length] = '\0';
+	// a result this short is one of the shared strings already
+	if (a->length + b->length <= SHORT_STRING_MAX)
+	{
+		ObjString *result = a->length != 0 ? a : b;
+		pop();
+		pop();
+		push(OBJ_VAL(result));
+		return;
+	}
 
-	ObjString *result = takeString(chars, length);
+	// a and b are still on the stack so they survive allocation
+	ObjString *result = allocateString(a->length + b->length);
+	memcpy(result->chars, a->chars, a->length);
+	memcpy(result->chars + a->length, b->chars, b->length);
 
 	pop();
 	pop();
 	push(OBJ_VAL(result));
 }
 
+// joins the top count values of the stack into one string for an
+// interpolated string literal. the final length is known before
+// anything is copied, so exactly one string gets allocated
+static void buildString(int count)
+{
+	const char *chars[UINT8_COUNT];
+	int lengths[UINT8_COUNT];
+	char numbers[UINT8_COUNT][NUMBER_BUFFER_SIZE];
+	int length = 0;
+
+	for (int i = 0; i < count; i++)
+	{
+		Value value = peek(count - 1 - i);
+		if (IS_STRING(value))
+		{
+			chars[i] = AS_CSTRING(value);
+			lengths[i] = AS_STRING(value)->length;
+		}
+		else if (IS_NUMBER(value))
+		{
+			lengths[i] = formatNumber(AS_NUMBER(value), numbers[i]);
+			chars[i] = numbers[i];
+		}
+		else
+		{
+			chars[i] = valueToString(value);
+			lengths[i] = strlen(chars[i]);
+		}
+		length += lengths[i];
+	}
+
+	// the parts are still on the stack so they survive allocation
+	char buf[SHORT_STRING_MAX + 1];
+	ObjString *result = NULL;
+	char *dest = buf;
+	if (length > SHORT_STRING_MAX)
+	{
+		result = allocateString(length);
+		dest = result->chars;
+	}
+
+	for (int i = 0; i < count; i++)
+	{
+		memcpy(dest, chars[i], lengths[i]);
+		dest += lengths[i];
+	}
+
+	if (result == NULL)
+		result = copyUninternedString(buf, length);
+
+	vm.stackTop -= count;
+	push(OBJ_VAL(result));
+}
+
 
 
 
@@ -738,7 +876,9 @@ static InterpretResult run(bool repl_mode)
 		case OP_SET_UPVALUE:
 		{
 			uint8_t slot = READ_BYTE();
-			*frame->closure->upvalues[slot]->location = peek(0);
+			ObjUpvalue *upvalue = frame->closure->upvalues[slot];
+			*upvalue->location = peek(0);
+			writeBarrier((Obj *)upvalue);
 			break;
 		}
 		case OP_DEFINE_FIELD:
@@ -747,6 +887,7 @@ static InterpretResult run(bool repl_mode)
 			Value type = READ_CONSTANT();
 			tableSet(&AS_CLASS(peek(1))->fields, name, peek(0));
 			tableSet(&AS_CLASS(peek(1))->fieldsTypes, name, type);
+			writeBarrier(AS_OBJ(peek(1)));
 			pop();
 			break;
 		}
@@ -784,7 +925,7 @@ static InterpretResult run(bool repl_mode)
 				if (!tableGet(&module->fields, name, &value))
 				{
 					runtimeError("Undefined property '%s' of module '%s'.",
-						name->chars, module->name.chars);
+						name->chars, module->name->chars);
 					return INTERPRET_RUNTIME_ERROR;
 				}
 
@@ -795,10 +936,9 @@ static InterpretResult run(bool repl_mode)
 
 			else
 			{
-				Value value = peek(0);
 				ObjString *name = READ_STRING();
 				
-				if (!bindNativeMethod(value, name))
+				if (!bindNativeMethod(name))
 				{
 					return INTERPRET_RUNTIME_ERROR;
 				}
@@ -835,6 +975,7 @@ static InterpretResult run(bool repl_mode)
 					return INTERPRET_RUNTIME_ERROR;
 
 				tableSet(&instance->fields, field, peek(0));
+				writeBarrier((Obj *)instance);
 				
 				Value value = pop();
 				pop();
@@ -866,6 +1007,7 @@ static InterpretResult run(bool repl_mode)
 					return INTERPRET_RUNTIME_ERROR;
 
 				tableSet(&module->fields, field, peek(0));
+				writeBarrier((Obj *)module);
 
 				Value value = pop();
 				pop();
@@ -893,6 +1035,16 @@ static InterpretResult run(bool repl_mode)
 		}
 		case OP_GET_INDEX:
 		{
+			if (IS_MAP(peek(1)))
+			{
+				Value key = pop();
+				Value value;
+				if (!valueTableGet(&AS_MAP(pop())->table, key, &value))
+					value = NULL_VAL;
+				push(value);
+				break;
+			}
+
 			int index = AS_NUMBER(pop());
 			ObjArray *array = AS_ARRAY(pop());
 			
@@ -912,6 +1064,18 @@ static InterpretResult run(bool repl_mode)
 		}
 		case OP_SET_INDEX:
 		{
+			if (IS_MAP(peek(2)))
+			{
+				// key and value stay on the stack in case the table grows
+				ObjMap *map = AS_MAP(peek(2));
+				valueTableSet(&map->table, peek(1), peek(0));
+				writeValueBarrier((Obj *)map, peek(1));
+				writeValueBarrier((Obj *)map, peek(0));
+				vm.stackTop -= 3;
+				push(OBJ_VAL(map));
+				break;
+			}
+
 			Value newvalue = pop();
 			int index = AS_NUMBER(pop());
 			ObjArray *array = AS_ARRAY(pop());
@@ -927,11 +1091,21 @@ static InterpretResult run(bool repl_mode)
 			}
 
 			setValueArray(&array->array, index, newvalue);
+			writeValueBarrier((Obj *)array, newvalue);
 			push(OBJ_VAL(array));
 			break;
 		}
 		case OP_ARRAY_LENGTH:
 		{
+			// Foreach over a map walks a snapshot of its keys. the map
+			// was duplicated just before, so both copies get replaced
+			if (IS_MAP(peek(0)))
+			{
+				ObjArray *keys = mapKeys(AS_MAP(peek(0)));
+				vm.stackTop[-2] = OBJ_VAL(keys);
+				vm.stackTop[-1] = OBJ_VAL(keys);
+			}
+
 			Value array = pop();
 			if (!IS_ARRAY(array))
 			{
@@ -945,22 +1119,39 @@ static InterpretResult run(bool repl_mode)
 		{
 			uint8_t length = READ_BYTE();
 			ObjArray *array = newArray();
-			
-			ValueArray values;
-			initValueArray(&values);
-			for (int j = 0; j < length; j++)
-			{
-				writeValueArray(&values, pop());
-			}
-			// reverse items
-			for (int j = length-1; j >= 0; j--)
+			push(OBJ_VAL(array));
+
+			// the items stay below the array until it holds them
+			Value *items = vm.stackTop - 1 - length;
+			if (length > 0)
 			{
-				writeValueArray(&array->array, values.values[j]);
+				array->array.values = GROW_ARRAY(Value, NULL, 0, length);
+				array->array.capacity = length;
+				memcpy(array->array.values, items, sizeof(Value) * length);
+				array->array.count = length;
+				writeBarrier((Obj *)array);
 			}
-			freeValueArray(&values);
+
+			vm.stackTop = items;
 			push(OBJ_VAL(array));
 			break;
 		}
+		case OP_MAP:
+		{
+			uint8_t length = READ_BYTE();
+			ObjMap *map = newMap();
+			push(OBJ_VAL(map));
+
+			// the pairs stay below the map until it holds them
+			Value *pairs = vm.stackTop - 1 - 2 * length;
+			for (int j = 0; j < length; j++)
+				valueTableSet(&map->table, pairs[2 * j], pairs[2 * j + 1]);
+			writeBarrier((Obj *)map);
+
+			vm.stackTop = pairs;
+			push(OBJ_VAL(map));
+			break;
+		}
 		case OP_EQUAL:
 		{
 			Value b = pop();
@@ -986,11 +1177,15 @@ static InterpretResult run(bool repl_mode)
 			}
 			else if (IS_ARRAY(peek(0)) && IS_ARRAY(peek(1)))
 			{
-				ObjArray *b = AS_ARRAY(pop());
-				ObjArray *a = AS_ARRAY(pop());
+				// both stay on the stack while a grows
+				ObjArray *b = AS_ARRAY(peek(0));
+				ObjArray *a = AS_ARRAY(peek(1));
 				for (int i = 0; i < b->array.count; i++)
 					writeValueArray(&a->array, b->array.values[i]);
+				writeBarrier((Obj *)a);
 				freeValueArray(&b->array);
+				pop();
+				pop();
 				push(OBJ_VAL(a));
 			}
 			else if (IS_NUMBER(peek(0)) && IS_NUMBER(peek(1)))
@@ -1006,6 +1201,9 @@ static InterpretResult run(bool repl_mode)
 			}
 			break;
 		}
+		case OP_BUILD_STRING:
+			buildString(READ_BYTE());
+			break;
 		case OP_INCREMENT:
 		{
 			if(!IS_NUMBER(peek(0)))
@@ -1098,6 +1296,11 @@ static InterpretResult run(bool repl_mode)
 		{
 			uint16_t offset = READ_SHORT();
 			frame->ip -= offset;
+			// loops are where long running programs spend their time,
+			// and no object or scratch pointers are held here
+			scratchClear();
+			if (vm.compactPending)
+				compactHeap();
 			break;
 		}
 		case OP_CALL:
@@ -1153,6 +1356,7 @@ static InterpretResult run(bool repl_mode)
 					closure->upvalues[i] = frame->closure->upvalues[index];
 				}
 			}
+			writeBarrier((Obj *)closure);
 			break;
 		}
 		case OP_CLOSE_UPVALUE:
@@ -1180,6 +1384,7 @@ static InterpretResult run(bool repl_mode)
 			tableAddAll(&AS_CLASS(superclass)->methods, &subclass->methods);
 			tableAddAll(&AS_CLASS(superclass)->fields, &subclass->fields);
 			tableAddAll(&AS_CLASS(superclass)->fieldsTypes, &subclass->fieldsTypes);
+			writeBarrier((Obj *)subclass);
 			pop(); // Subclass.
 			break;
 		}
@@ -1282,6 +1487,7 @@ static InterpretResult run(bool repl_mode)
 			ObjModule *module = newModule(name, filepath);
 			tableAddAll(&vm.globals, &module->fields);
 			tableAddAll(&vm.globalsTypes, &module->fieldsTypes);
+			writeBarrier((Obj *)module);
 
 			// restore old vm
 			vm = oldVm;
@@ -1297,7 +1503,12 @@ static InterpretResult run(bool repl_mode)
 					"Expected return type %s, not %s."))
 				return INTERPRET_RUNTIME_ERROR;
 
+			if (frame->memoEntry != -1)
+				memoStore(AS_MEMO(frame->slots[0]), frame->memoEntry,
+					frame->memoStamp, result);
+
 			closeUpvalues(frame->slots);
+			scratchClear(); // recursion does not loop
 			vm.frameCount--;
 			if (vm.frameCount == 0)
 			{
@@ -1352,8 +1563,11 @@ static InterpretResult run(bool repl_mode)
 // interpret shit and return its result
 InterpretResult interpret(const char *path, const char *source, bool repl_mode)
 {
-	tableSet(&vm.nativeVars, copyString("_SCRIPT", 7), 
-		OBJ_VAL(copyString(path, strlen(path))));
+	push(OBJ_VAL(copyString("_SCRIPT", 7)));
+	push(OBJ_VAL(copyString(path, strlen(path))));
+	tableSet(&vm.nativeVars, AS_STRING(vm.stackTop[-2]), vm.stackTop[-1]);
+	pop();
+	pop();
 	
 	ObjFunction *function = compile(source);
 	if (function == NULL)
@@ -1362,9 +1576,20 @@ InterpretResult interpret(const char *path, const char *source, bool repl_mode)
 	push(OBJ_VAL(function));
 	ObjClosure *closure = newClosure(function);
 	pop();
+	// running into the heap cap reports a runtime error and lands here
+	jmp_buf heapJump;
+	jmp_buf *outerJump = vm.heapJump;
+	if (setjmp(heapJump) != 0)
+	{
+		vm.heapJump = outerJump;
+		return INTERPRET_RUNTIME_ERROR;
+	}
+	vm.heapJump = &heapJump;
+
 	push(OBJ_VAL(closure));
 	call(closure, 0);
 	InterpretResult result = run(repl_mode);
+	vm.heapJump = outerJump;
 	#ifdef DEBUG_TRACE_EXECUTION
 		printf("\n");
 	#endif